@@ -1,6 +1,7 @@
 
 FUNCTION void create_background_shader()
 {
+#if !HEADLESS
     // Shader input layout.
     D3D11_INPUT_ELEMENT_DESC layout_desc[] = 
     {
@@ -50,6 +51,7 @@ FUNCTION void create_background_shader()
     String8 hlsl = 
 #include "background.hlsl"
     d3d11_compile_shader(hlsl, layout_desc, ARRAYSIZE(layout_desc), &background_input_layout, &background_vs, &background_ps);
+#endif
 }
 
 FUNCTION void background_init()
@@ -62,6 +64,7 @@ FUNCTION void background_init()
 
 FUNCTION void background_draw()
 {
+#if !HEADLESS
     // Bind Input Assembler.
     device_context->IASetInputLayout(background_input_layout);
     device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
@@ -94,4 +97,5 @@ FUNCTION void background_draw()
     
     // Draw.
     device_context->Draw(6, 0);
+#endif
 }
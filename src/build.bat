@@ -43,9 +43,11 @@ cl /O2 /MT  /DDEVELOPER=0 /DNDEBUG /Fenur.exe %CF% ..\src\win32_main.cpp /link /
 REM Delete intermediates
 del *.obj *.res >NUL
 
-REM Copy data folder to build folder
+REM Copy data folder to build folder. Not levels.pkg: the game builds a fresh one from the .nlf files
+REM on its first run, so a stale package in the tree never ships.
 rd /S /Q .\data
 xcopy ..\data .\data /E /I /Y >NUL
+if exist .\data\levels.pkg del .\data\levels.pkg
 
 popd
 popd
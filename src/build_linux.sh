@@ -0,0 +1,23 @@
+#!/bin/sh
+
+# Headless Linux build (see linux_headless_main.cpp) and the level solver (linux_solver_main.cpp). No window, renderer or audio device, so it's
+# release-only: the editor and ImGui only exist in DEVELOPER builds.
+#
+# CF: common compiler flags; LF: common linker flags.
+#
+CF="-std=c++17 -fno-exceptions -ffast-math -g -Wall -Wno-unused-function -Wno-unused-variable -Wno-unused-but-set-variable -Wno-write-strings -Wno-missing-braces -Wno-sign-compare -Wno-comment -I../src/vendor"
+LF="-lm"
+
+cd "$(dirname "$0")"
+mkdir -p ../build
+cd ../build
+
+# Release build
+c++ -O2 -DDEVELOPER=0 -DNDEBUG $CF ../src/linux_headless_main.cpp -o nur_headless $LF || exit 1
+c++ -O2 -DDEVELOPER=0 -DNDEBUG $CF ../src/linux_solver_main.cpp -o nur_solver $LF -pthread || exit 1
+
+# Copy data folder to build folder. Not levels.pkg: the game builds a fresh one from the .nlf files
+# on its first run, so a stale package in the tree never ships.
+rm -rf ./data
+cp -r ../data ./data
+rm -f ./data/levels.pkg
@@ -65,21 +65,779 @@ FUNCTION void set_player_position(s32 x, s32 y, u8 dir, b32 teleport = FALSE)
     pdir = dir;
 }
 
+FUNCTION void obj_map_point(Obj_Map *map, u8 *block, s32 cols, s32 rows)
+{
+    // Lay the planes over `block`, which must hold cols*rows*12 bytes.
+    s32 n      = cols*rows;
+    map->pitch = cols;
+    map->rows  = rows;
+    map->type  = block;
+    map->dir   = block + n;
+    map->flags = block + n*2;
+    map->c     = block + n*3;
+    map->color = block + n*4;
+}
+
+FUNCTION void obj_map_init(Obj_Map *map, Arena *arena, s32 cols, s32 rows)
+{
+    obj_map_point(map, PUSH_ARRAY_ZERO(arena, u8, cols*rows*12), cols, rows);
+}
+
+FUNCTION void obj_map_copy(Obj_Map *dst, Obj_Map *src)
+{
+    // Both maps must have the same size; all planes live in one block starting at type.
+    ASSERT(dst->pitch == src->pitch && dst->rows == src->rows);
+    MEMORY_COPY(dst->type, src->type, dst->pitch*dst->rows*12);
+}
+
+FUNCTION Obj get_obj(Obj_Map *map, s32 i)
+{
+    Obj result;
+    result.flags = map->flags[i];
+    result.type  = map->type[i];
+    result.dir   = map->dir[i];
+    result.c     = map->c[i];
+    MEMORY_COPY(result.color, &map->color[i*8], 8);
+    return result;
+}
+
+FUNCTION void set_obj(Obj_Map *map, s32 i, Obj o)
+{
+    map->flags[i] = o.flags;
+    map->type[i]  = o.type;
+    map->dir[i]   = o.dir;
+    map->c[i]     = o.c;
+    MEMORY_COPY(&map->color[i*8], o.color, 8);
+}
+
+FUNCTION void swap_objs(Obj_Map *map, s32 a, s32 b)
+{
+    Obj obj_a = get_obj(map, a);
+    set_obj(map, a, get_obj(map, b));
+    set_obj(map, b, obj_a);
+}
+
+FUNCTION b32 is_outside_map(s32 x, s32 y)
+{
+    b32 result = ((x < 0) || (x > NUM_X*SIZE_X-1) ||
+                  (y < 0) || (y > NUM_Y*SIZE_Y-1));
+    return result;
+}
+
+FUNCTION u8 mix_colors(u8 cur, u8 src)
+{
+    u8 result = color_mix_table[cur][src];
+    return result;
+}
+
+FUNCTION u8 obj_index_list(u8 type)
+{
+    u8 result = type == T_DOOR_OPEN? (u8)T_DOOR : type;
+    return result;
+}
+
+FUNCTION void obj_index_init(Obj_Index *index, Arena *arena)
+{
+    s32 num_squares = NUM_X*SIZE_X*NUM_Y*SIZE_Y;
+    
+    for (s32 i = 0; i < T_COUNT; i++)
+        index->squares[i] = PUSH_ARRAY(arena, s32, num_squares);
+    index->slot    = PUSH_ARRAY(arena, s32, num_squares);
+    index->width   = NUM_X*SIZE_X;
+    index->rebuild = TRUE;
+}
+
+FUNCTION void obj_index_update(Obj_Index *index)
+{
+    if (!index->rebuild)
+        return;
+    
+    MEMORY_ZERO_ARRAY(index->counts);
+    for (s32 y = 0; y < NUM_Y*SIZE_Y; y++) {
+        for (s32 x = 0; x < NUM_X*SIZE_X; x++) {
+            s32 square          = y*index->width + x;
+            u8 list             = obj_index_list(objmap.type[MAP_IDX(x, y)]);
+            index->slot[square] = -1;
+            if (list == T_EMPTY)
+                continue;
+            
+            index->slot[square]                        = index->counts[list];
+            index->squares[list][index->counts[list]++] = square;
+        }
+    }
+    
+    index->rebuild = FALSE;
+}
+
+FUNCTION V2s obj_index_get(Obj_Index *index, u8 type, s32 i)
+{
+    s32 square = index->squares[type][i];
+    V2s result = v2s(square % index->width, square / index->width);
+    return result;
+}
+
+FUNCTION void obj_index_swap(Obj_Index *index, s32 x0, s32 y0, s32 x1, s32 y1)
+{
+    // The objs on [x0,y0] and [x1,y1] were just swapped.
+    if (index->rebuild)
+        return;
+    
+    s32 a = y0*index->width + x0;
+    s32 b = y1*index->width + x1;
+    SWAP(index->slot[a], index->slot[b], s32);
+    if (index->slot[a] >= 0)
+        index->squares[obj_index_list(objmap.type[MAP_IDX(x0, y0)])][index->slot[a]] = a;
+    if (index->slot[b] >= 0)
+        index->squares[obj_index_list(objmap.type[MAP_IDX(x1, y1)])][index->slot[b]] = b;
+}
+
+FUNCTION void beams_init(Beam_Tracer *tracer, Arena *arena)
+{
+    // Allocate the beam tracer for the current map size.
+    s32 num_squares = NUM_X*SIZE_X*NUM_Y*SIZE_Y;
+    
+    tracer->stack_capacity  = 2 * num_squares * 8 * NUM_BEAM_COLORS;
+    tracer->stack           = PUSH_ARRAY(arena, Beam_Work, tracer->stack_capacity);
+    tracer->stack_count     = 0;
+    tracer->lasers_capacity = num_squares;
+    tracer->lasers          = PUSH_ARRAY(arena, Beam_Laser, tracer->lasers_capacity);
+    tracer->lasers_count    = 0;
+    
+    tracer->segments_capacity  = num_squares * 8 * NUM_BEAM_COLORS;
+    tracer->segments           = PUSH_ARRAY(arena, Beam_Segment, tracer->segments_capacity);
+    tracer->first_free_segment = -1;
+    
+    tracer->width           = NUM_X*SIZE_X;
+    tracer->num_squares     = num_squares;
+    tracer->visited         = PUSH_ARRAY(arena, u64, num_squares);
+    tracer->owner           = PUSH_ARRAY(arena, s32, num_squares);
+    tracer->next            = PUSH_ARRAY(arena, s32, num_squares);
+    tracer->first_segment   = PUSH_ARRAY(arena, s32, num_squares);
+    tracer->blocks          = PUSH_ARRAY(arena, u8,  num_squares);
+    tracer->jump            = PUSH_ARRAY(arena, u16, num_squares * 8);
+    tracer->rebuild         = TRUE;
+}
+
+FUNCTION b32 beams_square_blocks(s32 x, s32 y)
+{
+    b32 result = ((tilemap[MAP_IDX(x, y)] == Tile_WALL) ||
+                  (objmap.type[MAP_IDX(x, y)] != T_EMPTY && objmap.type[MAP_IDX(x, y)] != T_DOOR_OPEN));
+    return result;
+}
+
+FUNCTION void beams_build_jump_table(Beam_Tracer *tracer)
+{
+    for (s32 i = 0; i < tracer->num_squares; i++)
+        tracer->blocks[i] = (u8)beams_square_blocks(i % tracer->width, i / tracer->width);
+    
+    for (u8 d = 0; d < 8; d++) {
+        // Visit squares so that [x,y]+dir is always done before [x,y].
+        s32 dx = dirs[d].x;
+        s32 dy = dirs[d].y;
+        for (s32 j = 0; j < NUM_Y*SIZE_Y; j++) {
+            s32 y = dy > 0? NUM_Y*SIZE_Y-1 - j : j;
+            for (s32 i = 0; i < NUM_X*SIZE_X; i++) {
+                s32 x = dx > 0? NUM_X*SIZE_X-1 - i : i;
+                
+                u16 k = 1;
+                if (!is_outside_map(x + dx, y + dy)) {
+                    s32 next_square = (y + dy)*tracer->width + (x + dx);
+                    if (!tracer->blocks[next_square])
+                        k += tracer->jump[next_square*8 + d];
+                }
+                tracer->jump[(y*tracer->width + x)*8 + d] = k;
+            }
+        }
+    }
+}
+
+FUNCTION void beams_update_jump_table(Beam_Tracer *tracer, s32 x, s32 y)
+{
+    // [x,y] started or stopped blocking beams; fix the squares whose jump lands on or past it.
+    s32 square = y*tracer->width + x;
+    b32 blocks = beams_square_blocks(x, y);
+    if (blocks == (b32)tracer->blocks[square])
+        return;
+    tracer->blocks[square] = (u8)blocks;
+    
+    for (u8 d = 0; d < 8; d++) {
+        u16 k_past = blocks? 0 : tracer->jump[square*8 + d];
+        for (s32 k = 1; ; k++) {
+            s32 test_x = x - k*dirs[d].x;
+            s32 test_y = y - k*dirs[d].y;
+            if (is_outside_map(test_x, test_y))
+                break;
+            
+            s32 test_square = test_y*tracer->width + test_x;
+            tracer->jump[test_square*8 + d] = (u16)(k + k_past);
+            if (tracer->blocks[test_square])
+                break;
+        }
+    }
+}
+
+FUNCTION s32 beams_blocker_behind(Beam_Tracer *tracer, s32 x, s32 y, u8 dir, s32 *distance)
+{
+    // Returns the square a beam going in `dir` through [x,y] must have left from, or -1.
+    u8 back    = WRAP_D(dir + 4);
+    s32 k      = tracer->jump[(y*tracer->width + x)*8 + back];
+    s32 test_x = x + k*dirs[back].x;
+    s32 test_y = y + k*dirs[back].y;
+    if (is_outside_map(test_x, test_y))
+        return -1;
+    
+    *distance = k;
+    return test_y*tracer->width + test_x;
+}
+
+FUNCTION void beams_mark_all_dirty(Beam_Tracer *tracer)
+{
+    tracer->rebuild = TRUE;
+}
+
+FUNCTION s32 beams_find(Beam_Tracer *tracer, s32 laser)
+{
+    while (tracer->lasers[laser].parent != laser) {
+        tracer->lasers[laser].parent = tracer->lasers[tracer->lasers[laser].parent].parent;
+        laser = tracer->lasers[laser].parent;
+    }
+    return laser;
+}
+
+FUNCTION void beams_mark_dirty(Beam_Tracer *tracer, s32 x, s32 y)
+{
+    // Something on [x,y] moved, rotated or opened; retrace the group of lasers that lit it.
+    //
+    // @Note: A moved obj carries the colors it had on its old square, and nothing clears them if
+    // the new square isn't lit, so we clear them here.
+    //
+    s32 i = MAP_IDX(x, y);
+    if (objmap.type[i] != T_DOOR && objmap.type[i] != T_DOOR_OPEN)
+        MEMORY_ZERO(&objmap.color[i*8], 8);
+    
+    if (tracer->rebuild)
+        return;
+    
+    // Beams that hit or left [x,y].
+    s32 square = y*tracer->width + x;
+    s32 owner  = tracer->owner[square];
+    if (owner >= 0)
+        tracer->lasers[beams_find(tracer, owner)].dirty = TRUE;
+    
+    // Beams that passed over [x,y], if it didn't block them.
+    if (!tracer->blocks[square]) {
+        for (u8 d = 0; d < 8; d++) {
+            s32 distance = 0;
+            s32 from     = beams_blocker_behind(tracer, x, y, d, &distance);
+            if (from < 0 || tracer->owner[from] < 0)
+                continue;
+            
+            for (s32 i = tracer->first_segment[from]; i >= 0; i = tracer->segments[i].next) {
+                if (tracer->segments[i].dir == d) {
+                    tracer->lasers[beams_find(tracer, tracer->owner[from])].dirty = TRUE;
+                    break;
+                }
+            }
+        }
+    }
+    
+    beams_update_jump_table(tracer, x, y);
+}
+
+FUNCTION s32 beams_claim(Beam_Tracer *tracer, s32 laser, s32 x, s32 y)
+{
+    // Called for the laser's own square and every obj a beam of `laser` hits. Returns -1, or the
+    // root of a group that isn't being retraced but already claimed this square.
+    //
+    s32 square = y*tracer->width + x;
+    s32 owner  = tracer->owner[square];
+    if (owner < 0) {
+        tracer->owner[square]              = laser;
+        tracer->next[square]               = tracer->lasers[laser].first_square;
+        tracer->lasers[laser].first_square = square;
+        return -1;
+    }
+    
+    if (!tracer->lasers[owner].retracing)
+        return beams_find(tracer, owner);
+    
+    // Both lasers light this square, so they end up in the same group.
+    s32 a = beams_find(tracer, laser);
+    s32 b = beams_find(tracer, owner);
+    if (a != b)
+        tracer->lasers[MAX(a, b)].parent = MIN(a, b);
+    return -1;
+}
+
+FUNCTION void beams_release_squares(Beam_Tracer *tracer, s32 laser)
+{
+    // Give back every square `laser` claimed and clear whatever its beams wrote there.
+    s32 square = tracer->lasers[laser].first_square;
+    while (square >= 0) {
+        // @Note: Squares are numbered like map indices, tracer->width is the map pitch.
+        if (objmap.type[square] != T_DOOR && objmap.type[square] != T_DOOR_OPEN)
+            MEMORY_ZERO(&objmap.color[square*8], 8);
+        
+        // Free the segments leaving this square.
+        s32 segment = tracer->first_segment[square];
+        while (segment >= 0) {
+            s32 next                       = tracer->segments[segment].next;
+            tracer->segments[segment].next = tracer->first_free_segment;
+            tracer->first_free_segment     = segment;
+            segment                        = next;
+        }
+        
+        tracer->first_segment[square] = -1;
+        tracer->visited[square]       = 0;
+        tracer->owner[square]         = -1;
+        square                        = tracer->next[square];
+    }
+    tracer->lasers[laser].first_square = -1;
+}
+
+FUNCTION void beams_add_segment(Beam_Tracer *tracer, s32 laser, s32 x, s32 y, u8 dir, u8 color, s32 lit_length)
+{
+    s32 i = tracer->first_free_segment;
+    ASSERT(i >= 0);
+    tracer->first_free_segment = tracer->segments[i].next;
+    
+    s32 square               = y*tracer->width + x;
+    Beam_Segment *segment    = &tracer->segments[i];
+    segment->x               = (s16)x;
+    segment->y               = (s16)y;
+    segment->dir             = dir;
+    segment->color           = color;
+    segment->lit_length      = (u16)lit_length;
+    segment->laser           = laser;
+    segment->seq             = tracer->seq++;
+    segment->next            = tracer->first_segment[square];
+    tracer->first_segment[square] = i;
+}
+
+FUNCTION u8 beams_color_at(Beam_Tracer *tracer, s32 x, s32 y)
+{
+    // Mix every beam that lit [x,y] in the order a full retrace would.
+    Beam_Segment *lit[8*NUM_BEAM_COLORS];
+    s32 lit_count = 0;
+    for (u8 d = 0; d < 8; d++) {
+        s32 distance = 0;
+        s32 from     = beams_blocker_behind(tracer, x, y, d, &distance);
+        if (from < 0)
+            continue;
+        
+        for (s32 i = tracer->first_segment[from]; i >= 0; i = tracer->segments[i].next) {
+            Beam_Segment *segment = &tracer->segments[i];
+            if (segment->dir != d || segment->lit_length < distance)
+                continue;
+            
+            // Insertion sort by (laser, seq).
+            ASSERT(lit_count < ARRAY_COUNT(lit));
+            s32 j = lit_count++;
+            while (j > 0 && ((lit[j-1]->laser > segment->laser) ||
+                             (lit[j-1]->laser == segment->laser && lit[j-1]->seq > segment->seq))) {
+                lit[j] = lit[j-1];
+                j--;
+            }
+            lit[j] = segment;
+        }
+    }
+    
+    u8 result = Color_WHITE;
+    for (s32 i = 0; i < lit_count; i++)
+        result = mix_colors(result, lit[i]->color);
+    return result;
+}
+
+FUNCTION void push_beam_work(Beam_Tracer *tracer, u8 type, s32 x, s32 y, u8 dir, u8 color, u8 old_color = 0)
+{
+    ASSERT(tracer->stack_count < tracer->stack_capacity);
+    
+    Beam_Work *w = &tracer->stack[tracer->stack_count++];
+    w->x         = (s16)x;
+    w->y         = (s16)y;
+    w->type      = type;
+    w->dir       = dir;
+    w->color     = color;
+    w->old_color = old_color;
+}
+
+FUNCTION void push_beam_trace(Beam_Tracer *tracer, s32 x, s32 y, u8 dir, u8 color)
+{
+    // @Note: Tracing the same (square, dir, color) twice in one retrace can't light anything new,
+    // so we skip it. This is also what bounds the work for loops.
+    //
+    u64 m = 1ULL << (dir*NUM_BEAM_COLORS + color);
+    u64 *visited = &tracer->visited[y*tracer->width + x];
+    if (*visited & m)
+        return;
+    *visited |= m;
+    
+    push_beam_work(tracer, BeamWork_TRACE, x, y, dir, color);
+}
+
+FUNCTION s32 beams_trace_laser(Beam_Tracer *tracer, s32 laser)
+{
+    // Returns -1 on success, or the root of another group we ran into (the caller must retrace
+    // that group together with ours).
+    //
+    // @Note: Work items are popped in the same order the old recursive version made its calls; a
+    // splitter pushes its deferred reflected beam (EMIT) below the penetrating one (TRACE).
+    //
+    Beam_Laser *l = &tracer->lasers[laser];
+    Obj laser_o   = get_obj(&objmap, MAP_IDX(l->x, l->y));
+    s32 conflict  = beams_claim(tracer, laser, l->x, l->y);
+    if (conflict >= 0)
+        return conflict;
+    
+    tracer->stack_count = 0;
+    tracer->seq         = 0;
+    push_beam_trace(tracer, l->x, l->y, laser_o.dir, laser_o.c);
+    
+    while (tracer->stack_count > 0) {
+        Beam_Work w  = tracer->stack[--tracer->stack_count];
+        s32 src_x    = w.x;
+        s32 src_y    = w.y;
+        u8 src_dir   = w.dir;
+        u8 src_color = w.color;
+        
+        if (w.type == BeamWork_EMIT) {
+            // Write the color if not already written.
+            if (src_color != w.old_color) {
+                s32 i = MAP_IDX(src_x, src_y);
+                u8 c  = objmap.c[i] == Color_WHITE? mix_colors(w.old_color, src_color) : objmap.c[i];
+                objmap.color[i*8 + src_dir] = c;
+                push_beam_trace(tracer, src_x, src_y, src_dir, c);
+            }
+            continue;
+        }
+        
+        // Jump straight to whatever stops the beam.
+        s32 k      = tracer->jump[(src_y*tracer->width + src_x)*8 + src_dir];
+        s32 test_x = src_x + k*dirs[src_dir].x;
+        s32 test_y = src_y + k*dirs[src_dir].y;
+        if (is_outside_map(test_x, test_y) || tilemap[MAP_IDX(test_x, test_y)] == Tile_WALL) {
+            beams_add_segment(tracer, laser, src_x, src_y, src_dir, src_color, k - 1);
+            continue;
+        }
+        
+        conflict = beams_claim(tracer, laser, test_x, test_y);
+        if (conflict >= 0)
+            return conflict;
+        
+        // The obj we hit is lit too, in case player is standing on some Obj like T_DETECTOR.
+        beams_add_segment(tracer, laser, src_x, src_y, src_dir, src_color, k);
+        s32 test_i = MAP_IDX(test_x, test_y);
+        Obj test_o = get_obj(&objmap, test_i);
+        u8 *color  = &objmap.color[test_i*8];
+        
+        // We hit an object, so we should determine which color to reflect in which dir.  
+        switch (test_o.type) {
+            case T_DOOR:
+            case T_LASER: {
+            } break;
+            case T_MIRROR:
+            case T_BENDER:
+            case T_SPLITTER: {
+                Beam_Optics optics = beam_optics.e[test_o.type][test_o.dir][src_dir];
+                u8 reflected_d     = optics.reflected;
+                
+                if (test_o.type != T_SPLITTER) {
+                    // Write the color if not already written AND direction is valid.
+                    if ((reflected_d != U8_MAX) && (src_color != test_o.color[reflected_d])) {
+                        color[reflected_d] = mix_colors(test_o.color[reflected_d], src_color);
+                        push_beam_trace(tracer, test_x, test_y, reflected_d, color[reflected_d]);
+                    }
+                } else {
+                    // Reflected direction (deferred until the penetrating beam is done).
+                    //
+                    if (reflected_d != U8_MAX)
+                        push_beam_work(tracer, BeamWork_EMIT, test_x, test_y, reflected_d, src_color, test_o.color[reflected_d]);
+                    
+                    // Source direction.
+                    //
+                    if (optics.penetrate) {
+                        u8 c = test_o.c == Color_WHITE? mix_colors(test_o.color[src_dir], src_color) : test_o.c;
+                        color[src_dir] = c;
+                        push_beam_trace(tracer, test_x, test_y, src_dir, c);
+                    }
+                }
+            } break;
+            case T_DETECTOR: {
+                // Write the color if not already written.
+                if (src_color != test_o.color[src_dir]) {
+                    color[src_dir] = mix_colors(test_o.color[src_dir], src_color);
+                    push_beam_trace(tracer, test_x, test_y, src_dir, color[src_dir]);
+                }
+            } break;
+        }
+    }
+    
+    return -1;
+}
+
+FUNCTION void beams_update(Beam_Tracer *tracer)
+{
+    if (tracer->rebuild) {
+        tracer->rebuild      = FALSE;
+        tracer->lasers_count = 0;
+        
+        // Start from a clean map.
+        for (u8 type = 0; type < T_COUNT; type++) {
+            if (type == T_DOOR)
+                continue;
+            
+            for (s32 i = 0; i < obj_index.counts[type]; i++) {
+                s32 square = obj_index.squares[type][i];
+                MEMORY_ZERO(&objmap.color[square*8], 8);
+            }
+        }
+        
+        // Collect lasers (red ones first).
+        for (s32 pass = 0; pass < 2; pass++) {
+            for (s32 i = 0; i < obj_index.counts[T_LASER]; i++) {
+                s32 square = obj_index.squares[T_LASER][i];
+                s32 x      = square % tracer->width;
+                s32 y      = square / tracer->width;
+                if ((objmap.c[square] == Color_RED) == (pass == 0)) {
+                    ASSERT(tracer->lasers_count < tracer->lasers_capacity);
+                    
+                    Beam_Laser *l = &tracer->lasers[tracer->lasers_count];
+                    l->x            = (s16)x;
+                    l->y            = (s16)y;
+                    l->parent       = tracer->lasers_count;
+                    l->first_square = -1;
+                    l->dirty        = TRUE;
+                    l->retracing    = FALSE;
+                    tracer->lasers_count++;
+                }
+            }
+        }
+        MEMORY_ZERO(tracer->visited, tracer->num_squares * sizeof(tracer->visited[0]));
+        for (s32 i = 0; i < tracer->num_squares; i++) {
+            tracer->owner[i]         = -1;
+            tracer->first_segment[i] = -1;
+        }
+        tracer->first_free_segment = -1;
+        for (s32 i = tracer->segments_capacity-1; i >= 0; i--) {
+            tracer->segments[i].next   = tracer->first_free_segment;
+            tracer->first_free_segment = i;
+        }
+        
+        beams_build_jump_table(tracer);
+    }
+    
+    // Collect the groups that need a retrace.
+    b32 any_dirty = FALSE;
+    for (s32 i = 0; i < tracer->lasers_count; i++) {
+        tracer->lasers[i].retracing = tracer->lasers[beams_find(tracer, i)].dirty;
+        any_dirty |= tracer->lasers[i].retracing;
+    }
+    
+    while (any_dirty) {
+        for (s32 i = 0; i < tracer->lasers_count; i++) {
+            if (tracer->lasers[i].retracing)
+                beams_release_squares(tracer, i);
+        }
+        for (s32 i = 0; i < tracer->lasers_count; i++) {
+            if (tracer->lasers[i].retracing)
+                tracer->lasers[i].parent = i;
+        }
+        
+        s32 conflict = -1;
+        for (s32 i = 0; (i < tracer->lasers_count) && (conflict < 0); i++) {
+            if (tracer->lasers[i].retracing)
+                conflict = beams_trace_laser(tracer, i);
+        }
+        if (conflict < 0)
+            break;
+        
+        // Our beams now reach squares lit by another group. Colors mix in laser order, so we
+        // can't just add our beams on top of theirs; retrace both groups from scratch.
+        //
+        for (s32 i = 0; i < tracer->lasers_count; i++) {
+            if (!tracer->lasers[i].retracing && beams_find(tracer, i) == conflict)
+                tracer->lasers[i].retracing = TRUE;
+        }
+    }
+    
+    for (s32 i = 0; i < tracer->lasers_count; i++) {
+        tracer->lasers[i].dirty     = FALSE;
+        tracer->lasers[i].retracing = FALSE;
+    }
+    
+    pcolor = beams_color_at(tracer, px, py);
+}
+
+FUNCTION void door_index_init(Door_Index *index, Arena *arena)
+{
+    s32 num_squares = NUM_X*SIZE_X*NUM_Y*SIZE_Y;
+    
+    index->detectors       = PUSH_ARRAY(arena, V2s, num_squares);
+    index->doors           = PUSH_ARRAY(arena, V2s, num_squares);
+    index->groups_capacity = NUM_X*NUM_Y*8;
+    index->groups          = PUSH_ARRAY(arena, Door_Group, index->groups_capacity);
+    index->rebuild         = TRUE;
+}
+
+FUNCTION void door_index_build(Door_Index *index)
+{
+    index->detectors_count = 0;
+    index->doors_count     = 0;
+    index->groups_count    = 0;
+    
+    for (s32 room_y = 0; room_y < NUM_Y*SIZE_Y; room_y += SIZE_Y) {
+        for (s32 room_x = 0; room_x < NUM_X*SIZE_X; room_x += SIZE_X) {
+            for (u8 c = 0; c < 8; c++) {
+                Door_Group group      = {};
+                group.c               = c;
+                group.first_detector  = index->detectors_count;
+                group.first_door      = index->doors_count;
+                
+                for (s32 y = room_y; y < room_y+SIZE_Y; y++) {
+                    for (s32 x = room_x; x < room_x+SIZE_X; x++) {
+                        Obj o = get_obj(&objmap, MAP_IDX(x, y));
+                        if (o.c != c)
+                            continue;
+                        
+                        if (o.type == T_DETECTOR) {
+                            index->detectors[index->detectors_count++] = v2s(x, y);
+                            group.detectors_count++;
+                        } else if (o.type == T_DOOR || o.type == T_DOOR_OPEN) {
+                            index->doors[index->doors_count++] = v2s(x, y);
+                            group.doors_count++;
+                        }
+                    }
+                }
+                
+                // Detectors without doors don't open anything.
+                if (!group.doors_count) {
+                    index->detectors_count = group.first_detector;
+                    continue;
+                }
+                
+                ASSERT(index->groups_count < index->groups_capacity);
+                index->groups[index->groups_count++] = group;
+            }
+        }
+    }
+    
+    index->rebuild = FALSE;
+}
+
+FUNCTION void door_index_update(Door_Index *index, b32 *opened = 0, b32 *closed = 0)
+{
+    // @Note: Reports door changes through `opened` and `closed` instead of playing sounds, so the
+    // solver can run this off the main thread.
+    //
+    if (index->rebuild)
+        door_index_build(index);
+    
+    for (s32 g = 0; g < index->groups_count; g++) {
+        Door_Group group = index->groups[g];
+        
+        // Count the lit detectors.
+        s32 lit_count  = 0;
+        b32 any_unlit  = FALSE;
+        for (s32 i = group.first_detector; i < group.first_detector + group.detectors_count; i++) {
+            Obj detector = get_obj(&objmap, MAP_IDX(index->detectors[i].x, index->detectors[i].y));
+            u8 final_c   = Color_WHITE;
+            for (s32 d = 0; d < 8; d++)
+                final_c = mix_colors(final_c, detector.color[d]);
+            
+            if (final_c == group.c)
+                lit_count++;
+            else
+                any_unlit = TRUE;
+        }
+        
+        // A door opens once enough detectors are lit, and closes if it's short of that while some
+        // detector is unlit. Otherwise it stays as it is.
+        //
+        for (s32 i = group.first_door; i < group.first_door + group.doors_count; i++) {
+            s32 x     = index->doors[i].x;
+            s32 y     = index->doors[i].y;
+            s32 j     = MAP_IDX(x, y);
+            u8 *color = &objmap.color[j*8];
+            color[1]  = (u8)lit_count;
+            
+            if (lit_count > 0 && lit_count >= color[0]) {
+                if (objmap.type[j] == T_DOOR) {
+                    if (opened) *opened = TRUE;
+                    objmap.type[j] = T_DOOR_OPEN;
+                    beams_mark_dirty(&beam_tracer, x, y);
+                }
+            } else if (any_unlit && lit_count < color[0]) {
+                if (objmap.type[j] == T_DOOR_OPEN) {
+                    if (closed) *closed = TRUE;
+                    objmap.type[j] = T_DOOR;
+                    beams_mark_dirty(&beam_tracer, x, y);
+                }
+            }
+        }
+    }
+}
+
 // @Todo: Must organize files.
 #include "undo.h"
 GLOBAL Undo_Handler undo_handler;
 
-
 // @Cleanup: Cleanup serialization stuff.
 // @Cleanup: Cleanup serialization stuff.
 //
+FUNCTION String_Builder begin_save_buffer()
+{
+    // Saves are built in game->save_arena, which is reserved once, then handed to the background
+    // writer, which takes a copy.
+    String_Builder result = {};
+    result.arena          = game->save_arena;
+    result.capacity       = SB_BLOCK_SIZE;
+    sb_reset(&result);
+    return result;
+}
+
+FUNCTION void save_level_state(String_Builder *sb)
+{
+    Loaded_Level *lev  = &game->loaded_level;
+    Obj_Map *pristine  = &lev->obj_map;
+    
+    Save_Level_State h = {};
+    h.manifest_hash    = manifest.hash;
+    if (objmap.type && lev->idx == current_level_idx &&
+        pristine->pitch == objmap.pitch && pristine->rows == objmap.rows) {
+        h.pitch = objmap.pitch;
+        h.rows  = objmap.rows;
+    }
+    h.px   = px;
+    h.py   = py;
+    h.pdir = pdir;
+    
+    // Count first so the cells can go straight after the header.
+    s32 n = h.pitch*h.rows;
+    for (s32 i = 0; i < n; i++) {
+        if (objmap.type[i] != pristine->type[i] || objmap.dir[i] != pristine->dir[i] ||
+            objmap.flags[i] != pristine->flags[i] || objmap.c[i] != pristine->c[i])
+            h.cells_count++;
+    }
+    sb_append(sb, &h);
+    
+    for (s32 i = 0; i < n; i++) {
+        if (objmap.type[i] != pristine->type[i] || objmap.dir[i] != pristine->dir[i] ||
+            objmap.flags[i] != pristine->flags[i] || objmap.c[i] != pristine->c[i]) {
+            Save_Cell cell = {(u32)i, objmap.type[i], objmap.dir[i], objmap.flags[i], objmap.c[i]};
+            sb_append(sb, &cell);
+        }
+    }
+    
+    if (n) undo_save(&undo_handler, sb);
+}
+
 FUNCTION void save_game()
 {
-    if (!game_started)
+    // @Note: Don't let a replay overwrite the player's progress.
+    if (!game_started || replay.mode == ReplayMode_PLAYING)
         return;
     
-    String_Builder sb = sb_init();
-    defer(sb_free(&sb));
+    String_Builder sb = begin_save_buffer();
     
     Loaded_Level *lev  = &game->loaded_level;
     s32 latest_version = SaveFileVersion_COUNT-1;
@@ -96,18 +854,67 @@ FUNCTION void save_game()
     s.master_volume          = master_volume;
     
     sb_append(&sb, &s, sizeof(Settings));
+    save_level_state(&sb);
     
-    Arena *a           = os->permanent_arena;
     Arena_Temp scratch = get_scratch(0, 0);
-    os->write_entire_file(sprint(scratch.arena, "%Ssave.dat", os->data_folder), sb_to_string(&sb, a));
+    os->write_entire_file_async(sprint(scratch.arena, "%Ssave.dat", os->data_folder), string(sb.start, sb.length));
     free_scratch(scratch);
 }
 
+FUNCTION void level_buffers_init(s32 num_cols, s32 num_rows)
+{
+    // @Note: Every live buffer is per square, so current_level_arena is sized from the level
+    // instead of a fixed max. A level that doesn't fit gets a new arena; nothing in the old one
+    // survives a reset anyway.
+    //
+    u64 size = (u64)num_cols*num_rows*LEVEL_BYTES_PER_SQUARE + KILOBYTES(4);
+    if (!current_level_arena || current_level_arena->max < size) {
+        if (current_level_arena)
+            arena_free(current_level_arena);
+        current_level_arena = arena_init(size);
+    }
+    
+    Arena *a = current_level_arena;
+    arena_reset(a);
+    obj_map_init(&objmap, a, num_cols, num_rows);
+    tilemap = PUSH_ARRAY_ZERO(a, u8, num_rows*num_cols);
+    
+    obj_index_init(&obj_index, a);
+    beams_init(&beam_tracer, a);
+    door_index_init(&door_index, a);
+}
+
+FUNCTION void level_buffers_swap(Level_Buffers *buffers)
+{
+    SWAP(current_level_arena, buffers->arena,       Arena *);
+    SWAP(NUM_X,               buffers->num_x,       s32);
+    SWAP(NUM_Y,               buffers->num_y,       s32);
+    SWAP(SIZE_X,              buffers->size_x,      s32);
+    SWAP(SIZE_Y,              buffers->size_y,      s32);
+    SWAP(tilemap,             buffers->tilemap,     u8 *);
+    SWAP(objmap,              buffers->objmap,      Obj_Map);
+    SWAP(beam_tracer,         buffers->beam_tracer, Beam_Tracer);
+    SWAP(door_index,          buffers->door_index,  Door_Index);
+    SWAP(obj_index,           buffers->obj_index,   Obj_Index);
+}
+
 FUNCTION void reload_map()
 {
-    Arena *a          = current_level_arena;
     Loaded_Level *lev = &game->loaded_level;
-    arena_reset(a);
+    
+    // @Note: If prefetch_level() built this level, its buffers are ready to go and the live ones
+    // become the spare set. Otherwise, the live buffers are sized only by the level dimensions, so
+    // if they already fit (restarting, or reloading a level of the same size) we keep them and just
+    // copy the pristine level over them. Otherwise reallocate everything for the new size.
+    //
+    b32 prefetched = game->prefetched.ready && game->prefetched.level_idx == lev->idx;
+    b32 same_size  = (!prefetched && objmap.type != 0 &&
+                      NUM_X  == lev->num_x  && NUM_Y  == lev->num_y &&
+                      SIZE_X == lev->size_x && SIZE_Y == lev->size_y);
+    if (prefetched) {
+        level_buffers_swap(&game->prefetched);
+        game->prefetched.ready = FALSE;
+    }
     
     current_level_idx = lev->idx;
     NUM_X             = lev->num_x;
@@ -120,26 +927,18 @@ FUNCTION void reload_map()
     s32 num_rows = lev->num_y*lev->size_y;
     s32 num_cols = lev->num_x*lev->size_x;
     
-    // Allocate memory for objmap.
-    objmap = PUSH_ARRAY(a, Obj*, num_rows);
-    for (s32 i = 0; i < num_rows; i++) 
-        objmap[i] = PUSH_ARRAY_ZERO(a, Obj, num_cols);
-    // Copy objmap.
-    for (s32 y = 0; y < num_rows; y++) {
-        for (s32 x = 0; x < num_cols; x++) {
-            objmap[y][x] = lev->obj_map[y][x];
-        }
+    if (same_size) {
+        obj_index.rebuild = TRUE;
+        beams_mark_all_dirty(&beam_tracer);
+        door_index.rebuild = TRUE;
+    } else if (!prefetched) {
+        level_buffers_init(num_cols, num_rows);
     }
     
-    // Allocate memory for tilemap.
-    tilemap = PUSH_ARRAY(a, u8*, num_rows);
-    for (s32 i = 0; i < num_rows; i++) 
-        tilemap[i] = PUSH_ARRAY_ZERO(a, u8, num_cols);
-    // Copy tilemap.
-    for (s32 y = 0; y < num_rows; y++) {
-        for (s32 x = 0; x < num_cols; x++) {
-            tilemap[y][x] = lev->tile_map[y][x];
-        }
+    // Copy the pristine level into the live maps.
+    if (!prefetched) {
+        obj_map_copy(&objmap, &lev->obj_map);
+        MEMORY_COPY(tilemap, lev->tile_map, num_rows*num_cols);
     }
     
     // Set default state.
@@ -153,8 +952,253 @@ FUNCTION void reload_map()
     undo_handler_reset(&undo_handler);
 }
 
-FUNCTION b32 load_level(String8 level_name)
+FUNCTION String8 next_manifest_token(String8 *line)
+{
+    while (line->count && is_whitespace(line->data[0]))
+        advance(line, 1);
+    
+    String8 result = string(line->data, 0);
+    while (result.count < line->count && !is_whitespace(line->data[result.count]))
+        result.count++;
+    advance(line, result.count);
+    return result;
+}
+
+FUNCTION b32 load_level_manifest(Level_Manifest *m)
 {
+    Arena_Temp scratch = get_scratch(0, 0);
+    defer(free_scratch(scratch));
+    
+    String8 file = os->map_file(sprint(scratch.arena, "%Slevels.txt", os->data_folder));
+    if (!file.data) {
+        print("Couldn't load level manifest!\n");
+        return FALSE;
+    }
+    defer(os->unmap_file(file));
+    
+    // First pass: collect the entries to know how many ids there are.
+    Level_Info *entries = PUSH_ARRAY_ZERO(scratch.arena, Level_Info, file.count);
+    s32 *entry_ids      = PUSH_ARRAY(scratch.arena, s32, file.count);
+    s32 entries_count   = 0;
+    s32 max_id          = -1;
+    
+    String8 rest = file;
+    for (s32 line_number = 1; rest.count; line_number++) {
+        String8 line = string(rest.data, 0);
+        while (line.count < rest.count && rest.data[line.count] != '\n')
+            line.count++;
+        advance(&rest, line.count + 1);
+        
+        String8 id_token = next_manifest_token(&line);
+        if (!id_token.count || id_token.data[0] == '#')
+            continue;
+        
+        s32 id = 0;
+        for (s32 i = 0; i < id_token.count; i++) {
+            if (!is_numeric(id_token.data[i]) || id > 100000) {
+                id = -1;
+                break;
+            }
+            id = id*10 + (id_token.data[i] - '0');
+        }
+        
+        String8 name = next_manifest_token(&line);
+        if (id < 0 || !name.count) {
+            print("levels.txt(%d): Expected \"<id> <name> [flags...]\"!\n", line_number);
+            continue;
+        }
+        
+        Level_Info info = {};
+        info.name       = name;
+        for (String8 flag = next_manifest_token(&line); flag.count; flag = next_manifest_token(&line)) {
+            if      (flag == S8LIT("info_controls")) info.flags |= LevelFlags_INFO_CONTROLS;
+            else if (flag == S8LIT("info_mixing"))   info.flags |= LevelFlags_INFO_MIXING;
+            else print("levels.txt(%d): Unknown flag %S!\n", line_number, flag);
+        }
+        
+        entries[entries_count]   = info;
+        entry_ids[entries_count] = id;
+        entries_count++;
+        max_id = MAX(max_id, id);
+    }
+    
+    // Second pass: lay the levels out by id.
+    m->levels_count = max_id + 1;
+    m->levels       = PUSH_ARRAY_ZERO(os->permanent_arena, Level_Info, m->levels_count);
+    m->hash         = get_hash(file);
+    table_init(&m->ids);
+    for (s32 i = 0; i < entries_count; i++) {
+        Level_Info *level = &m->levels[entry_ids[i]];
+        if (level->name.count || table_find_pointer(&m->ids, entries[i].name)) {
+            print("levels.txt: Level %S (id %d) is listed twice!\n", entries[i].name, entry_ids[i]);
+            continue;
+        }
+        
+        level->name  = string_copy(os->permanent_arena, entries[i].name);
+        level->flags = entries[i].flags;
+        table_add(&m->ids, level->name, entry_ids[i]);
+    }
+    
+    return TRUE;
+}
+
+FUNCTION u32 put_varint(u8 *dst, u32 value)
+{
+    u32 count = 0;
+    while (value >= 0x80) {
+        dst[count++] = (u8)(value | 0x80);
+        value      >>= 7;
+    }
+    dst[count++] = (u8)value;
+    return count;
+}
+
+FUNCTION b32 get_varint(String8 *src, u32 *value)
+{
+    *value = 0;
+    for (u32 shift = 0; shift < 32; shift += 7) {
+        if (!src->count)
+            return FALSE;
+        
+        u8 byte = src->data[0];
+        advance(src, 1);
+        *value |= (u32)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+FUNCTION u32 rle_encode(u8 *dst, u8 *src, u32 size)
+{
+    // Tokens are a varint header followed by bytes: (count << 1) | 1 is a run of count copies of
+    // the next byte, (count << 1) is count literal bytes. `dst` must hold 2*size + 16 bytes.
+    //
+    u32 result  = 0;
+    u32 literal = 0; // Start of the pending literals.
+    u32 i       = 0;
+    while (i < size) {
+        u32 run = 1;
+        while (i + run < size && src[i + run] == src[i])
+            run++;
+        
+        if (run >= 3 || i + run == size) {
+            if (run < 3)
+                i += run;
+            
+            if (literal < i) {
+                result += put_varint(dst + result, (i - literal) << 1);
+                MEMORY_COPY(dst + result, src + literal, i - literal);
+                result += i - literal;
+            }
+            if (run >= 3) {
+                result     += put_varint(dst + result, (run << 1) | 1);
+                dst[result++] = src[i];
+                i          += run;
+            }
+            literal = i;
+        } else {
+            i += run;
+        }
+    }
+    return result;
+}
+
+FUNCTION b32 rle_decode(u8 *dst, u32 size, String8 src)
+{
+    u32 i = 0;
+    while (src.count) {
+        u32 header = 0;
+        if (!get_varint(&src, &header))
+            return FALSE;
+        
+        u32 count = header >> 1;
+        if (count > size - i)
+            return FALSE;
+        
+        if (header & 1) {
+            if (!src.count)
+                return FALSE;
+            MEMORY_SET(dst + i, src.data[0], count);
+            advance(&src, 1);
+        } else {
+            if (count > src.count)
+                return FALSE;
+            MEMORY_COPY(dst + i, src.data, count);
+            advance(&src, count);
+        }
+        i += count;
+    }
+    return i == size;
+}
+
+FUNCTION void put_level_plane(String_Builder *sb, u8 *plane, u32 size)
+{
+    // A plane is stored as its size, a checksum of its bytes, its encoding, the stored size, then
+    // the stored bytes. Most squares are empty floor, so planes are run-length encoded unless that
+    // doesn't make them smaller.
+    //
+    Arena_Temp scratch = get_scratch(0, 0);
+    u8 *encoded        = PUSH_ARRAY(scratch.arena, u8, 2*size + 16);
+    u32 encoded_size   = rle_encode(encoded, plane, size);
+    
+    u32 checksum    = get_hash(string(plane, size));
+    u8 encoding     = encoded_size < size? PlaneEncoding_RLE : PlaneEncoding_RAW;
+    u32 stored_size = encoding == PlaneEncoding_RLE? encoded_size : size;
+    sb_append(sb, &size);
+    sb_append(sb, &checksum);
+    sb_append(sb, &encoding);
+    sb_append(sb, &stored_size);
+    sb_append(sb, encoding == PlaneEncoding_RLE? encoded : plane, stored_size);
+    
+    free_scratch(scratch);
+}
+
+FUNCTION b32 get_level_plane(String8 *file, u8 *plane, u32 size, s32 version)
+{
+    u32 stored_size = 0, checksum = 0;
+    if (file->count < 2*sizeof(u32))
+        return FALSE;
+    get(file, &stored_size);
+    get(file, &checksum);
+    if (stored_size != size)
+        return FALSE;
+    
+    // Planes are raw before LevelVersion_RLE.
+    u8 encoding = PlaneEncoding_RAW;
+    if (version >= LevelVersion_RLE) {
+        if (file->count < sizeof(u8) + sizeof(u32))
+            return FALSE;
+        get(file, &encoding);
+        get(file, &stored_size);
+    }
+    if (file->count < stored_size)
+        return FALSE;
+    
+    String8 bytes = string(file->data, stored_size);
+    advance(file, stored_size);
+    
+    switch (encoding) {
+        case PlaneEncoding_RAW: {
+            if (stored_size != size)
+                return FALSE;
+            MEMORY_COPY(plane, bytes.data, size);
+        } break;
+        case PlaneEncoding_RLE: {
+            if (!rle_decode(plane, size, bytes))
+                return FALSE;
+        } break;
+        default: return FALSE;
+    }
+    
+    b32 result = get_hash(string(plane, size)) == checksum;
+    return result;
+}
+
+FUNCTION b32 parse_level(String8 file, String8 level_name, Loaded_Level *lev, Arena *a)
+{
+    // Parses an .nlf file of any version into `lev`, migrating it to the latest format.
+    //
     // @Todo: This serialization stuff is great but ugly; is there a way to make it cleaner?
     //
 #define RESTORE_FIELD(field, inclusion_version) \
@@ -176,25 +1220,9 @@ if (version >= (inclusion_version) && version < (removed_version)) \
 get(&file, &field_name, size); \
 } while(0)
     
-    Arena_Temp scratch = get_scratch(0, 0);
-    String8 file = os->read_entire_file(sprint(scratch.arena, "%Slevels/%S.nlf", os->data_folder, level_name));
-    free_scratch(scratch);
-    if (!file.data) {
-        print("Couldn't load level: %S\n", level_name);
-        return FALSE;
-    }
-    defer(os->free_file_memory(file.data));
-    
-    Arena *a          = game->loaded_level_arena;
-    Loaded_Level *lev = &game->loaded_level;
-    arena_reset(a);
-    
     s32 version = 0;
     get(&file, &version);
     
-    // @Todo: Once we implement package manager, we don't need to copy data. Instead, we load the 
-    // package in memory and just point to it, because the package will always be alive in memory.
-    //
     // @Todo: When writing strings to files, we should establish a convention to always write them
     // null-terminated. When loading, we load count, then in case of memcpy, we copy count+1 to 
     // account for null-terminator.
@@ -202,64 +1230,387 @@ get(&file, &field_name, size); \
     
     RESTORE_FIELD(lev->idx, LevelVersion_REMOVE_NAME_ADD_ID);
     
-#if DEVELOPER
-    if (level_names[lev->idx] != level_name) {
-        String8 got = level_names[lev->idx];
-        if (lev->idx >= ARRAY_COUNT(level_names))
-            got = S8LIT("name_out_of_bounds");
-        print("\nName mismatch!\n"
-              "expected %S but got %S\n"
-              "Save the game again to solve the issue!\n\n", level_name, got);
+#if DEVELOPER
+    if (lev->idx < 0 || lev->idx >= manifest.levels_count || manifest.levels[lev->idx].name != level_name) {
+        String8 got = S8LIT("name_out_of_bounds");
+        if (lev->idx >= 0 && lev->idx < manifest.levels_count)
+            got = manifest.levels[lev->idx].name;
+        print("\nName mismatch!\n"
+              "expected %S but got %S\n"
+              "Save the game again to solve the issue!\n\n", level_name, got);
+    }
+#endif
+    
+    // Load level size.
+    if (file.count < 4*sizeof(s32) + sizeof(Player)) {
+        print("Level %S is corrupted!\n", level_name);
+        return FALSE;
+    }
+    get(&file, &lev->num_x);
+    get(&file, &lev->num_y);
+    get(&file, &lev->size_x);
+    get(&file, &lev->size_y);
+    
+    // Load player data.
+    get(&file, &lev->player);
+    
+    // Check each side before their product, so a huge one can't wrap around.
+    s64 cols = (s64)lev->num_x*lev->size_x;
+    s64 rows = (s64)lev->num_y*lev->size_y;
+    if (lev->num_x <= 0 || lev->num_y <= 0 || lev->size_x <= 0 || lev->size_y <= 0 ||
+        cols > LEVEL_MAX_SQUARES || rows > LEVEL_MAX_SQUARES || cols*rows > LEVEL_MAX_SQUARES) {
+        print("Level %S has invalid dimensions %dx%d rooms of %dx%d!\n", level_name, lev->num_x, lev->num_y, lev->size_x, lev->size_y);
+        return FALSE;
+    }
+    
+    s32 num_rows = lev->num_y*lev->size_y;
+    s32 num_cols = lev->num_x*lev->size_x;
+    
+    // Allocate memory for obj_map and tile_map.
+    obj_map_init(&lev->obj_map, a, num_cols, num_rows);
+    lev->tile_map = PUSH_ARRAY_ZERO(a, u8, num_rows*num_cols);
+    
+    if (version >= LevelVersion_BULK) {
+        // Each plane is a single block.
+        s32 n     = num_rows*num_cols;
+        b32 valid = (get_level_plane(&file, lev->obj_map.type,  n,   version) &&
+                     get_level_plane(&file, lev->obj_map.dir,   n,   version) &&
+                     get_level_plane(&file, lev->obj_map.flags, n,   version) &&
+                     get_level_plane(&file, lev->obj_map.c,     n,   version) &&
+                     get_level_plane(&file, lev->obj_map.color, n*8, version) &&
+                     get_level_plane(&file, lev->tile_map,      n,   version));
+        if (!valid)
+            print("Level %S is corrupted!\n", level_name);
+        return valid;
+    }
+    
+    // Older versions store one Obj record per square, then one tile per square.
+    for (s32 i = 0; i < num_rows*num_cols; i++) {
+        Obj obj  = {};
+        Obj *dst = &obj;
+        
+        RESTORE_FIELD(dst->color, LevelVersion_INIT);
+        RESTORE_FIELD(dst->flags, LevelVersion_INIT);
+        RESTORE_FIELD(dst->type, LevelVersion_INIT);
+        RESTORE_FIELD(dst->dir, LevelVersion_INIT);
+        RESTORE_FIELD(dst->c, LevelVersion_INIT);
+        
+        // Colors used to be indices into the old palette; translate them to RGB masks.
+        if (version < LevelVersion_RGB_COLORS) {
+            u8 old_colors[] = {
+                Color_WHITE, Color_RED, Color_GREEN, Color_BLUE, Color_YELLOW, Color_MAGENTA, Color_CYAN,
+            };
+            dst->c = old_colors[dst->c % ARRAY_COUNT(old_colors)];
+            if (dst->type != T_DOOR && dst->type != T_DOOR_OPEN) {
+                for (s32 k = 0; k < ARRAY_COUNT(dst->color); k++)
+                    dst->color[k] = old_colors[dst->color[k] % ARRAY_COUNT(old_colors)];
+            }
+        }
+        
+        set_obj(&lev->obj_map, i, obj);
+    }
+    
+    for (s32 i = 0; i < num_rows*num_cols; i++)
+        get(&file, &lev->tile_map[i]);
+    
+    return TRUE;
+}
+
+FUNCTION void build_level_package(Level_Package *package, Arena *arena)
+{
+    // Parse every .nlf into one block laid out as described in game.h, then write it out as
+    // levels.pkg so the next run doesn't have to.
+    //
+    arena_reset(arena);
+    
+    // Levels saved from the editor might still be on their way to disk.
+    os->wait_for_file_writes();
+    
+    s32 levels_count               = manifest.levels_count;
+    Level_Package_Header *header   = PUSH_STRUCT_ZERO(arena, Level_Package_Header);
+    Level_Package_Entry *entries   = PUSH_ARRAY_ZERO(arena, Level_Package_Entry, levels_count);
+    header->magic                  = LEVEL_PACKAGE_MAGIC;
+    header->package_version        = LEVEL_PACKAGE_VERSION;
+    header->level_version          = LevelVersion_COUNT-1;
+    header->levels_count           = levels_count;
+    header->manifest_hash          = manifest.hash;
+    
+    for (s32 i = 0; i < levels_count; i++) {
+        String8 name = manifest.levels[i].name;
+        if (!name.count)
+            continue;
+        
+        Arena_Temp scratch = get_scratch(&arena, 1);
+        Arena *a           = scratch.arena;
+        
+        String8 file = os->map_file(sprint(a, "%Slevels/%S.nlf", os->data_folder, name));
+        Loaded_Level lev = {};
+        b32 parsed       = file.data && parse_level(file, name, &lev, a);
+        u32 source_hash  = file.data? get_hash(file) : 0;
+        os->unmap_file(file);
+        
+        if (parsed) {
+            s32 num_squares = lev.num_x*lev.size_x*lev.num_y*lev.size_y;
+            u8 *grid        = PUSH_ARRAY(arena, u8, num_squares*13);
+            MEMORY_COPY(grid, lev.obj_map.type, num_squares*12);
+            MEMORY_COPY(grid + num_squares*12, lev.tile_map, num_squares);
+            
+            Level_Package_Entry *e = &entries[i];
+            e->idx    = lev.idx;
+            e->num_x  = lev.num_x;
+            e->num_y  = lev.num_y;
+            e->size_x = lev.size_x;
+            e->size_y = lev.size_y;
+            e->player = lev.player;
+            e->offset = (u32)(grid - (u8*)header);
+        }
+        entries[i].source_hash = source_hash;
+        
+        free_scratch(scratch);
+    }
+    
+    u8 *end      = PUSH_ARRAY(arena, u8, 0);
+    header->size = (u32)(end - (u8*)header);
+    
+    package->data         = string((u8*)header, header->size);
+    package->entries      = entries;
+    package->levels_count = levels_count;
+    package->dirty        = FALSE;
+    
+    // It was built from the old package.
+    game->prefetched.ready = FALSE;
+    
+    Arena_Temp scratch = get_scratch(&arena, 1);
+    os->write_entire_file_async(sprint(scratch.arena, "%Slevels.pkg", os->data_folder), package->data);
+    free_scratch(scratch);
+}
+
+FUNCTION b32 load_level_package(Level_Package *package)
+{
+    // The mapping is never unmapped; the package stays in memory for the lifetime of the game.
+    Arena_Temp scratch = get_scratch(0, 0);
+    String8 file = os->map_file(sprint(scratch.arena, "%Slevels.pkg", os->data_folder));
+    free_scratch(scratch);
+    if (!file.data)
+        return FALSE;
+    
+    Level_Package_Header *header = (Level_Package_Header *)file.data;
+    b32 valid = (file.count >= sizeof(Level_Package_Header) &&
+                 header->magic           == LEVEL_PACKAGE_MAGIC &&
+                 header->package_version == LEVEL_PACKAGE_VERSION &&
+                 header->level_version   == LevelVersion_COUNT-1 &&
+                 header->levels_count    == manifest.levels_count &&
+                 header->manifest_hash   == manifest.hash &&
+                 header->size            == file.count);
+    
+    // Every entry's planes must lie inside the file. Each dimension is checked before multiplying,
+    // and offsets are u32, so nothing here can overflow.
+    //
+    Level_Package_Entry *entries = (Level_Package_Entry *)(header + 1);
+    if (valid)
+        valid = (sizeof(Level_Package_Header) + (u64)header->levels_count*sizeof(Level_Package_Entry) <= file.count);
+    for (s32 i = 0; valid && i < header->levels_count; i++) {
+        Level_Package_Entry *e = &entries[i];
+        if (!e->offset)
+            continue;
+        
+        s64 cols = (s64)e->num_x*e->size_x;
+        s64 rows = (s64)e->num_y*e->size_y;
+        valid = (e->num_x > 0 && e->num_y > 0 && e->size_x > 0 && e->size_y > 0 &&
+                 cols <= LEVEL_MAX_SQUARES && rows <= LEVEL_MAX_SQUARES &&
+                 cols*rows <= LEVEL_MAX_SQUARES &&
+                 (u64)e->offset + (u64)(cols*rows)*13 <= file.count);
+    }
+    
+    // @Note: The manifest can stay the same while a .nlf changes, so compare each level against the
+    // file it was built from. That's a read and a hash of every .nlf; they're small and there's no
+    // parsing. A missing .nlf keeps the packaged level, which lets the package ship on its own.
+    //
+    for (s32 i = 0; valid && i < header->levels_count; i++) {
+        String8 name = manifest.levels[i].name;
+        if (!name.count)
+            continue;
+        
+        Arena_Temp temp = get_scratch(0, 0);
+        String8 source  = os->map_file(sprint(temp.arena, "%Slevels/%S.nlf", os->data_folder, name));
+        free_scratch(temp);
+        if (!source.data)
+            continue;
+        
+        valid = entries[i].source_hash == get_hash(source);
+        os->unmap_file(source);
+    }
+    
+    if (!valid) {
+        print("Level package is out of date, rebuilding it.\n");
+        os->unmap_file(file);
+        return FALSE;
+    }
+    
+    package->data         = file;
+    package->entries      = entries;
+    package->levels_count = header->levels_count;
+    package->dirty        = FALSE;
+    return TRUE;
+}
+
+FUNCTION b32 load_level(s32 idx)
+{
+    Level_Package *package = &game->package;
+    if (package->dirty)
+        build_level_package(package, game->package_arena);
+    
+    if (idx < 0 || idx >= package->levels_count || !package->entries[idx].offset) {
+        print("Couldn't load level: %S\n", idx >= 0 && idx < manifest.levels_count? manifest.levels[idx].name : S8LIT("out_of_bounds"));
+        return FALSE;
+    }
+    
+    Level_Package_Entry *e = &package->entries[idx];
+    Loaded_Level *lev      = &game->loaded_level;
+    arena_reset(game->loaded_level_arena);
+    
+    // Point straight into the package; reload_map() copies into the live maps.
+    lev->idx    = e->idx;
+    lev->num_x  = e->num_x;
+    lev->num_y  = e->num_y;
+    lev->size_x = e->size_x;
+    lev->size_y = e->size_y;
+    lev->player = e->player;
+    
+    s32 num_rows    = lev->num_y*lev->size_y;
+    s32 num_cols    = lev->num_x*lev->size_x;
+    u8 *grid        = package->data.data + e->offset;
+    obj_map_point(&lev->obj_map, grid, num_cols, num_rows);
+    lev->tile_map   = grid + num_rows*num_cols*12;
+    
+    reload_map();
+    
+    return TRUE;
+}
+FUNCTION s32 find_level(String8 level_name)
+{
+    s32 *id    = table_find_pointer(&manifest.ids, level_name);
+    s32 result = id? *id : -1;
+    return result;
+}
+
+FUNCTION s32 next_level_idx()
+{
+    // Where the teleporter takes us; after the last level it's back to the intro.
+    s32 result = (current_level_idx + 1) < manifest.levels_count? current_level_idx + 1 : find_level(S8LIT("intro"));
+    return result;
+}
+
+FUNCTION void prefetch_level(s32 idx)
+{
+    // @Note: Builds level `idx` in game->prefetched, so that loading it later is a swap. That's the
+    // work load_level() and the first tick after it would do on the live buffers: sizing them,
+    // copying the pristine level in, indexing the objs, tracing the beams and indexing the doors.
+    // Opening doors is left to the first tick, same as after a plain load. Everything here works on
+    // the globals, so the spare set is swapped in meanwhile; the live player is put back too.
+    //
+    Level_Package *package = &game->package;
+    Level_Buffers *spare   = &game->prefetched;
+    if (package->dirty)
+        build_level_package(package, game->package_arena);
+    
+    spare->ready = FALSE;
+    if (idx < 0 || idx >= package->levels_count || !package->entries[idx].offset)
+        return;
+    
+    Level_Package_Entry *e = &package->entries[idx];
+    s32 num_cols = e->num_x*e->size_x;
+    s32 num_rows = e->num_y*e->size_y;
+    u8 *grid     = package->data.data + e->offset;
+    Obj_Map pristine;
+    obj_map_point(&pristine, grid, num_cols, num_rows);
+    
+    s32 live_px     = px;
+    s32 live_py     = py;
+    u8  live_pcolor = pcolor;
+    
+    level_buffers_swap(spare);
+    NUM_X  = e->num_x;
+    NUM_Y  = e->num_y;
+    SIZE_X = e->size_x;
+    SIZE_Y = e->size_y;
+    px     = e->player.x;
+    py     = e->player.y;
+    
+    level_buffers_init(num_cols, num_rows);
+    obj_map_copy(&objmap, &pristine);
+    MEMORY_COPY(tilemap, grid + num_rows*num_cols*12, num_rows*num_cols);
+    obj_index_update(&obj_index);
+    beams_update(&beam_tracer);
+    door_index_build(&door_index);
+    
+    level_buffers_swap(spare);
+    px     = live_px;
+    py     = live_py;
+    pcolor = live_pcolor;
+    
+    spare->ready     = TRUE;
+    spare->level_idx = idx;
+}
+
+FUNCTION b32 load_level(String8 level_name)
+{
+    s32 idx = find_level(level_name);
+    if (idx < 0) {
+        print("Couldn't load level: %S\n", level_name);
+        return FALSE;
     }
-#endif
-    
-    // Load level size.
-    get(&file, &lev->num_x);
-    get(&file, &lev->num_y);
-    get(&file, &lev->size_x);
-    get(&file, &lev->size_y);
     
-    // Load player data.
-    get(&file, &lev->player);
+    return load_level(idx);
+}
+
+FUNCTION void load_level_state(String8 *file)
+{
+    // @Note: Runs right after load_level(), so anything we reject just leaves the level pristine.
+    //
+    Save_Level_State h = {};
+    if (file->count < sizeof(h))
+        return;
+    get(file, &h);
     
-    s32 num_rows = lev->num_y*lev->size_y;
-    s32 num_cols = lev->num_x*lev->size_x;
+    s32 n = h.pitch*h.rows;
+    if (!n || h.manifest_hash != manifest.hash || h.pitch != objmap.pitch || h.rows != objmap.rows)
+        return;
+    if (h.cells_count < 0 || h.cells_count > n || file->count < (u64)h.cells_count*sizeof(Save_Cell))
+        return;
+    if (is_outside_map(h.px, h.py) || h.pdir < 0 || h.pdir >= 8)
+        return;
     
-    // Allocate memory for obj_map.
-    lev->obj_map = PUSH_ARRAY(a, Obj*, num_rows);
-    for (s32 i = 0; i < num_rows; i++) 
-        lev->obj_map[i] = PUSH_ARRAY_ZERO(a, Obj, num_cols);
-    // Load obj_map.
-    for (s32 y = 0; y < num_rows; y++) {
-        for (s32 x = 0; x < num_cols; x++) {
-            Obj *dst = &lev->obj_map[y][x];
-            
-            RESTORE_FIELD(dst->color, LevelVersion_INIT);
-            RESTORE_FIELD(dst->flags, LevelVersion_INIT);
-            RESTORE_FIELD(dst->type, LevelVersion_INIT);
-            RESTORE_FIELD(dst->dir, LevelVersion_INIT);
-            RESTORE_FIELD(dst->c, LevelVersion_INIT);
-        }
+    // Everything is checked before anything is applied, so a bad save can't leave the level half
+    // restored. Types and colors index tables, so they must be in range.
+    Save_Cell *cells = (Save_Cell *)file->data;
+    for (s32 i = 0; i < h.cells_count; i++) {
+        Save_Cell cell;
+        MEMORY_COPY(&cell, &cells[i], sizeof(Save_Cell));
+        if (cell.idx >= (u32)n || cell.type >= T_COUNT || cell.dir >= 8 || cell.c >= 8)
+            return;
     }
+    String8 log = *file;
+    advance(&log, h.cells_count*sizeof(Save_Cell));
+    if (!undo_log_valid(log))
+        return;
     
-    // Allocate memory for tile_map.
-    lev->tile_map = PUSH_ARRAY(a, u8*, num_rows);
-    for (s32 i = 0; i < num_rows; i++) 
-        lev->tile_map[i] = PUSH_ARRAY_ZERO(a, u8, num_cols);
-    // Load tile_map.
-    for (s32 y = 0; y < num_rows; y++) {
-        for (s32 x = 0; x < num_cols; x++) {
-            get(&file, &lev->tile_map[y][x]);
-        }
+    for (s32 i = 0; i < h.cells_count; i++) {
+        Save_Cell cell;
+        MEMORY_COPY(&cell, &cells[i], sizeof(Save_Cell));
+        objmap.type [cell.idx] = cell.type;
+        objmap.dir  [cell.idx] = cell.dir;
+        objmap.flags[cell.idx] = cell.flags;
+        objmap.c    [cell.idx] = cell.c;
     }
+    advance(file, h.cells_count*sizeof(Save_Cell));
     
-    reload_map();
+    set_player_position(h.px, h.py, (u8)h.pdir, TRUE);
+    obj_index.rebuild  = TRUE;
+    door_index.rebuild = TRUE;
+    beams_mark_all_dirty(&beam_tracer);
     
-    return TRUE;
-}
-FUNCTION b32 load_level(s32 idx)
-{
-    return load_level(level_names[idx]);
+    undo_load(&undo_handler, file);
 }
 
 FUNCTION b32 load_game()
@@ -277,13 +1628,16 @@ get(&file, &field_name); \
 } while(0)
     
     Arena_Temp scratch = get_scratch(0, 0);
-    String8 file = os->read_entire_file(sprint(scratch.arena, "%Ssave.dat", os->data_folder));
+    String8 mapping = os->map_file(sprint(scratch.arena, "%Ssave.dat", os->data_folder));
     free_scratch(scratch);
-    if (!file.data) {
+    if (!mapping.data) {
         print("Save file not present!\n");
         return FALSE;
     }
-    defer(os->free_file_memory(file.data));
+    defer(os->unmap_file(mapping));
+    
+    // @Note: get() advances file, so keep the mapping itself for unmap_file().
+    String8 file = mapping;
     
     s32 version = 0;
     get(&file, &version);
@@ -295,7 +1649,7 @@ get(&file, &field_name); \
         get(&file, &name_length);
         
         String8 name = string(file.data, name_length);
-        if (!load_level(name) || (name != level_names[game->loaded_level.idx])) {
+        if (!load_level(name) || (name != manifest.levels[game->loaded_level.idx].name)) {
             return FALSE;
         }
         
@@ -318,6 +1672,10 @@ get(&file, &field_name); \
     RESTORE_FIELD(prompt_user_on_restart, SaveFileVersion_INIT);
     RESTORE_FIELD(master_volume, SaveFileVersion_ADD_MASTER_VOLUME);
     
+    // Load progress in the level.
+    if (version >= SaveFileVersion_ADD_LEVEL_STATE)
+        load_level_state(&file);
+    
     game_started = TRUE;
     return TRUE;
 }
@@ -342,27 +1700,13 @@ FUNCTION void save_map()
     s32 num_rows = NUM_Y*SIZE_Y;
     s32 num_cols = NUM_X*SIZE_X;
     
-    // Allocate memory for obj_map.
-    lev->obj_map = PUSH_ARRAY(a, Obj*, num_rows);
-    for (s32 i = 0; i < num_rows; i++) 
-        lev->obj_map[i] = PUSH_ARRAY_ZERO(a, Obj, num_cols);
-    // Copy.
-    for (s32 y = 0; y < num_rows; y++) {
-        for (s32 x = 0; x < num_cols; x++) {
-            lev->obj_map[y][x] = objmap[y][x];
-        }
-    }
+    // Allocate and copy obj_map.
+    obj_map_init(&lev->obj_map, a, num_cols, num_rows);
+    obj_map_copy(&lev->obj_map, &objmap);
     
-    // Allocate memory for tile_map.
-    lev->tile_map = PUSH_ARRAY(a, u8*, num_rows);
-    for (s32 i = 0; i < num_rows; i++) 
-        lev->tile_map[i] = PUSH_ARRAY_ZERO(a, u8, num_cols);
-    // Copy.
-    for (s32 y = 0; y < num_rows; y++) {
-        for (s32 x = 0; x < num_cols; x++) {
-            lev->tile_map[y][x] = tilemap[y][x];
-        }
-    }
+    // Allocate and copy tile_map.
+    lev->tile_map = PUSH_ARRAY(a, u8, num_rows*num_cols);
+    MEMORY_COPY(lev->tile_map, tilemap, num_rows*num_cols);
 }
 
 FUNCTION b32 save_level(s32 level_idx)
@@ -372,8 +1716,7 @@ FUNCTION b32 save_level(s32 level_idx)
         return FALSE;
     }
     
-    String_Builder sb = sb_init();
-    defer(sb_free(&sb));
+    String_Builder sb = begin_save_buffer();
     
     Loaded_Level *lev = &game->loaded_level;
     s32 latest_version = LevelVersion_COUNT-1;
@@ -391,27 +1734,28 @@ FUNCTION b32 save_level(s32 level_idx)
     s32 num_rows = lev->num_y*lev->size_y;
     s32 num_cols = lev->num_x*lev->size_x;
     
-    // append obj_map.
-    for (s32 y = 0; y < num_rows; y++) {
-        for (s32 x = 0; x < num_cols; x++) {
-            sb_append(&sb, &lev->obj_map[y][x]);
-        }
-    }
-    
-    // append tile_map.
-    for (s32 y = 0; y < num_rows; y++) {
-        for (s32 x = 0; x < num_cols; x++) {
-            sb_append(&sb, &lev->tile_map[y][x]);
-        }
-    }
-    
+    // append obj_map and tile_map, a plane at a time.
+    u32 n = (u32)(num_rows*num_cols);
+    put_level_plane(&sb, lev->obj_map.type,  n);
+    put_level_plane(&sb, lev->obj_map.dir,   n);
+    put_level_plane(&sb, lev->obj_map.flags, n);
+    put_level_plane(&sb, lev->obj_map.c,     n);
+    put_level_plane(&sb, lev->obj_map.color, n*8);
+    put_level_plane(&sb, lev->tile_map,      n);
+    
+    // @Note: Write straight from the builder; sb_to_string() copies and drops the last byte when
+    // the buffer is exactly full.
+    //
     Arena_Temp scratch  = get_scratch(0, 0);
     Arena *a            = scratch.arena;
-    String8 path        = sprint(a, "%Slevels/%S.nlf", os->data_folder, level_names[level_idx]);
-    b32 result = os->write_entire_file(path, sb_to_string(&sb, a));
+    String8 path        = sprint(a, "%Slevels/%S.nlf", os->data_folder, manifest.levels[level_idx].name);
+    os->write_entire_file_async(path, string(sb.start, sb.length));
     free_scratch(scratch);
     
-    return result;
+    // The package still has the old version of this level.
+    game->package.dirty = TRUE;
+    
+    return TRUE;
 }
 
 FUNCTION b32 mouse_over_ui()
@@ -433,19 +1777,7 @@ FUNCTION void resize_current_level(s32 num_x, s32 num_y, s32 size_x, s32 size_y)
     set_default_zoom();
     update_camera(TRUE);
     
-    arena_reset(current_level_arena);
-	
-    s32 num_rows = NUM_Y*SIZE_Y;
-    s32 num_cols = NUM_X*SIZE_X;
-    
-    // Allocate memory for objmap.
-    objmap = PUSH_ARRAY(current_level_arena, Obj*, num_rows);
-    for (s32 i = 0; i < num_rows; i++) 
-        objmap[i] = PUSH_ARRAY_ZERO(current_level_arena, Obj, num_cols);
-    // Allocate memory for tilemap.
-    tilemap = PUSH_ARRAY(current_level_arena, u8*, num_rows);
-    for (s32 i = 0; i < num_rows; i++) 
-        tilemap[i] = PUSH_ARRAY_ZERO(current_level_arena, u8, num_cols);
+    level_buffers_init(NUM_X*SIZE_X, NUM_Y*SIZE_Y);
 }
 
 FUNCTION void make_empty_level()
@@ -453,12 +1785,16 @@ FUNCTION void make_empty_level()
     // Init map.
     for (s32 y = 0; y < NUM_Y*SIZE_Y; y++) {
         for (s32 x = 0; x < NUM_X*SIZE_X; x++) {
-            tilemap[y][x] = Tile_FLOOR;
-            objmap[y][x]  = {};
+            tilemap[MAP_IDX(x, y)] = Tile_FLOOR;
+            set_obj(&objmap, MAP_IDX(x, y), {});
         }
     }
     // Initial player and room position.
     set_player_position(0, 0, Dir_E, TRUE);
+    
+    obj_index.rebuild = TRUE;
+    beams_mark_all_dirty(&beam_tracer);
+    door_index.rebuild = TRUE;
 }
 
 FUNCTION void expand_current_level(s32 num_x, s32 num_y, s32 size_x, s32 size_y)
@@ -466,25 +1802,16 @@ FUNCTION void expand_current_level(s32 num_x, s32 num_y, s32 size_x, s32 size_y)
     Arena_Temp scratch = get_scratch(0, 0);
     defer(free_scratch(scratch));
     
-    u8  **old_tilemap;
-    Obj **old_objmap;
+    u8     *old_tilemap;
+    Obj_Map old_objmap;
     
     // Copy current level before resizing.
     s32 old_num_rows = NUM_Y*SIZE_Y;
     s32 old_num_cols = NUM_X*SIZE_X;
-    old_objmap = PUSH_ARRAY(scratch.arena, Obj*, old_num_rows);
-    for (s32 i = 0; i < old_num_rows; i++) 
-        old_objmap[i] = PUSH_ARRAY_ZERO(scratch.arena, Obj, old_num_cols);
-    old_tilemap = PUSH_ARRAY(scratch.arena, u8*, old_num_rows);
-    for (s32 i = 0; i < old_num_rows; i++) 
-        old_tilemap[i] = PUSH_ARRAY_ZERO(scratch.arena, u8, old_num_cols);
-    
-    for (s32 y = 0; y < old_num_rows; y++) {
-        for (s32 x = 0; x < old_num_cols; x++) {
-            old_tilemap[y][x] = tilemap[y][x];
-            old_objmap[y][x]  = objmap[y][x];
-        }
-    }
+    obj_map_init(&old_objmap, scratch.arena, old_num_cols, old_num_rows);
+    obj_map_copy(&old_objmap, &objmap);
+    old_tilemap = PUSH_ARRAY(scratch.arena, u8, old_num_rows*old_num_cols);
+    MEMORY_COPY(old_tilemap, tilemap, old_num_rows*old_num_cols);
     
     ////////////////////////////////
     
@@ -495,8 +1822,9 @@ FUNCTION void expand_current_level(s32 num_x, s32 num_y, s32 size_x, s32 size_y)
     s32 num_cols = MIN(old_num_cols, num_x*size_x);
     for (s32 y = 0; y < num_rows; y++) {
         for (s32 x = 0; x < num_cols; x++) {
-            tilemap[y][x] = old_tilemap[y][x];
-            objmap[y][x]  = old_objmap[y][x];
+            s32 old_i = y*old_num_cols + x;
+            tilemap[MAP_IDX(x, y)] = old_tilemap[old_i];
+            set_obj(&objmap, MAP_IDX(x, y), get_obj(&old_objmap, old_i));
         }
     }
 }
@@ -520,11 +1848,11 @@ FUNCTION void do_editor(b32 is_first_call)
         
         // Select level.
         LOCAL_PERSIST s32 selected_level_idx = 0;
-        const char* combo_preview_value = (const char*)level_names[selected_level_idx].data;
+        const char* combo_preview_value = (const char*)manifest.levels[selected_level_idx].name.data;
         if(ImGui::BeginCombo("Choose level", combo_preview_value)) {
-            for(int name_index = 0; name_index < IM_ARRAYSIZE(level_names); name_index++) {
+            for(int name_index = 0; name_index < manifest.levels_count; name_index++) {
                 const bool is_selected = (selected_level_idx == name_index);
-                if(ImGui::Selectable((const char*)level_names[name_index].data, is_selected)) {
+                if(ImGui::Selectable((const char*)manifest.levels[name_index].name.data, is_selected)) {
                     selected_level_idx = name_index;
                     
                     if (!load_level(selected_level_idx)) {
@@ -576,8 +1904,8 @@ FUNCTION void do_editor(b32 is_first_call)
         // Resave all levels.
         ImGui::SameLine(0, ImGui::GetFrameHeight()); 
         if (ImGui::Button("Resave All")) {
-            for (s32 i = 0; i < ARRAY_COUNT(level_names); i++) {
-                if (i >= 0 && i <= 3)
+            for (s32 i = 0; i < manifest.levels_count; i++) {
+                if ((i >= 0 && i <= 3) || !manifest.levels[i].name.count)
                     continue;
                 
                 if (load_level(i)) {
@@ -585,10 +1913,10 @@ FUNCTION void do_editor(b32 is_first_call)
                         ImGui::SameLine(); 
                         ImGui::Text("Saved all!");
                     } else {
-                        print("Couldn't save level %S\n", level_names[i]);
+                        print("Couldn't save level %S\n", manifest.levels[i].name);
                     }
                 } else {
-                    print("Couldn't load level %S\n", level_names[i]);
+                    print("Couldn't load level %S\n", manifest.levels[i].name);
                 }
             }
         }
@@ -711,7 +2039,8 @@ FUNCTION void do_editor(b32 is_first_call)
                 game->selected_tile_or_obj == T_DOOR     ||
                 game->selected_tile_or_obj == T_SPLITTER) {
                 ImGui::SameLine(0, ImGui::GetFrameHeight());
-                const char* cols[] = { "WHITE", "RED", "GREEN", "BLUE", "YELLOW", "MAGENTA", "CYAN", };
+                // @Note: Ordered by RGB mask, so the index is the color.
+                const char* cols[] = { "WHITE", "RED", "GREEN", "YELLOW", "BLUE", "MAGENTA", "CYAN", };
                 const char* col = cols[game->selected_color];
                 ImGui::ListBox("Color", &game->selected_color, cols, ARRAY_COUNT(cols));
             }
@@ -735,14 +2064,6 @@ FUNCTION void do_editor(b32 is_first_call)
 }
 #endif
 
-FUNCTION b32 is_outside_map(s32 x, s32 y)
-{
-    b32 result = ((x < 0) || (x > NUM_X*SIZE_X-1) ||
-                  (y < 0) || (y > NUM_Y*SIZE_Y-1));
-    return result;
-}
-
-GLOBAL Array<u32> unique_draw_beams_calls;
 FUNCTION void game_init()
 {
     game = PUSH_STRUCT_ZERO(os->permanent_arena, Game_State);
@@ -750,8 +2071,22 @@ FUNCTION void game_init()
     // Arenas init.
     // @Todo: If we notice that all levels are less than 1MB, we can simply decrease the max size
     // because we don't need to reserve that much.
+    //
+    // @Note: current_level_arena is sized per level by level_buffers_init().
     game->loaded_level_arena = arena_init(MEGABYTES(1));
-    current_level_arena      = arena_init(MEGABYTES(1));
+    game->package_arena      = arena_init(MEGABYTES(16));
+    game->save_arena         = arena_init(MEGABYTES(16));
+    
+    load_level_manifest(&manifest);
+    
+    // Load all levels at once. Developers edit the .nlf files, so always rebuild the package from
+    // them there.
+#if DEVELOPER
+    build_level_package(&game->package, game->package_arena);
+#else
+    if (!load_level_package(&game->package))
+        build_level_package(&game->package, game->package_arena);
+#endif
     
 #if DEVELOPER
     resize_current_level(1, 1, 8, 8);
@@ -763,8 +2098,6 @@ FUNCTION void game_init()
     
     game->rng = random_seed();
     
-    array_init(&unique_draw_beams_calls);
-    
     // Load textures.
     {
         // @Todo: Put particle textures inside the atlas!
@@ -810,6 +2143,9 @@ FUNCTION void game_init()
     particles_init();
     background_init();
     
+    // Before load_game(), which restores the undo log.
+    undo_handler_init(&undo_handler);
+    
     load_game();
     if (game_started)
         selection = 0;
@@ -820,10 +2156,8 @@ FUNCTION void game_init()
     update_camera(TRUE);
     set_world_to_view(v3(camera_pos, zoom_level));
     
-    undo_handler_init(&undo_handler);
-    
-    for (s32 i = 0; i < ARRAY_COUNT(level_names); i++) {
-        if (level_names[i] == S8LIT("primary_mixing_intro")) {
+    for (s32 i = 0; i < manifest.levels_count; i++) {
+        if (manifest.levels[i].flags & LevelFlags_INFO_MIXING) {
             game->idx_mixing_intro = i;
             break;
         }
@@ -857,8 +2191,8 @@ FUNCTION void swap_room(s32 dir_x, s32 dir_y)
     
     for (s32 y = room_y; y < room_y+SIZE_Y; y++) {
         for (s32 x = room_x; x < room_x+SIZE_X; x++) {
-            SWAP(objmap[y][x], objmap[y + SIZE_Y*dir_y][x + SIZE_X*dir_x], Obj);
-            SWAP(tilemap[y][x], tilemap[y + SIZE_Y*dir_y][x + SIZE_X*dir_x], u8);
+            swap_objs(&objmap, MAP_IDX(x, y), MAP_IDX(x + SIZE_X*dir_x, y + SIZE_Y*dir_y));
+            SWAP(tilemap[MAP_IDX(x, y)], tilemap[MAP_IDX(x + SIZE_X*dir_x, y + SIZE_Y*dir_y)], u8);
         }
     }
 }
@@ -873,24 +2207,24 @@ FUNCTION void flip_room_horizontally()
     for (s32 y = room_y; y <= room_end_y; y++) {
         for (s32 x = room_x; x <= room_end_x; x++) {
             // Flip directions.
-            u8 d = objmap[y][x].dir;
+            u8 d = objmap.dir[MAP_IDX(x, y)];
             if (d == Dir_E || d == Dir_W)
-                objmap[y][x].dir = WRAP_D(d + 4);
+                objmap.dir[MAP_IDX(x, y)] = WRAP_D(d + 4);
             else if (d == Dir_NE)
-                objmap[y][x].dir = Dir_NW;
+                objmap.dir[MAP_IDX(x, y)] = Dir_NW;
             else if (d == Dir_NW)
-                objmap[y][x].dir = Dir_NE;
+                objmap.dir[MAP_IDX(x, y)] = Dir_NE;
             else if (d == Dir_SW)
-                objmap[y][x].dir = Dir_SE;
+                objmap.dir[MAP_IDX(x, y)] = Dir_SE;
             else if (d == Dir_SE)
-                objmap[y][x].dir = Dir_SW;
+                objmap.dir[MAP_IDX(x, y)] = Dir_SW;
         }
     }
     for (s32 y = room_y; y <= room_end_y; y++) {
         for (s32 x = room_x; x <= (room_x + room_end_x)/2; x++) {
             // Flip objs and tiles.
-            SWAP(objmap[y][x], objmap[y][room_end_x - (x - room_x)], Obj);
-            SWAP(tilemap[y][x], tilemap[y][room_end_x - (x - room_x)], u8);
+            swap_objs(&objmap, MAP_IDX(x, y), MAP_IDX(room_end_x - (x - room_x), y));
+            SWAP(tilemap[MAP_IDX(x, y)], tilemap[MAP_IDX(room_end_x - (x - room_x), y)], u8);
         }
     }
 }
@@ -904,24 +2238,24 @@ FUNCTION void flip_room_vertically()
     for (s32 y = room_y; y <= room_end_y; y++) {
         for (s32 x = room_x; x <= room_end_x; x++) {
             // Flip directions.
-            u8 d = objmap[y][x].dir;
+            u8 d = objmap.dir[MAP_IDX(x, y)];
             if (d == Dir_N || d == Dir_S)
-                objmap[y][x].dir = WRAP_D(d + 4);
+                objmap.dir[MAP_IDX(x, y)] = WRAP_D(d + 4);
             else if (d == Dir_NE)
-                objmap[y][x].dir = Dir_SE;
+                objmap.dir[MAP_IDX(x, y)] = Dir_SE;
             else if (d == Dir_NW)
-                objmap[y][x].dir = Dir_SW;
+                objmap.dir[MAP_IDX(x, y)] = Dir_SW;
             else if (d == Dir_SW)
-                objmap[y][x].dir = Dir_NW;
+                objmap.dir[MAP_IDX(x, y)] = Dir_NW;
             else if (d == Dir_SE)
-                objmap[y][x].dir = Dir_NE;
+                objmap.dir[MAP_IDX(x, y)] = Dir_NE;
         }
     }
     for (s32 y = room_y; y <= (room_y + room_end_y)/2; y++) {
         for (s32 x = room_x; x <= room_end_x; x++) {
             // Flip objs and tiles.
-            SWAP(objmap[y][x], objmap[room_end_y - (y - room_y)][x], Obj);
-            SWAP(tilemap[y][x], tilemap[room_end_y - (y - room_y)][x], u8);
+            swap_objs(&objmap, MAP_IDX(x, y), MAP_IDX(x, room_end_y - (y - room_y)));
+            SWAP(tilemap[MAP_IDX(x, y)], tilemap[MAP_IDX(x, room_end_y - (y - room_y))], u8);
         }
     }
 }
@@ -939,12 +2273,12 @@ FUNCTION void load_next_level()
     if (teleport_transition_timer <= 0) {
         is_teleporting = FALSE;
         
-        // current level idx will be updated when calling load_level.
-        if ((current_level_idx + 1) < ARRAY_COUNT(level_names))
-            load_level(current_level_idx + 1);
-        else {
+        // current level idx will be updated when calling load_level. Its buffers were built by
+        // prefetch_level() when the teleport started.
+        b32 finished_last = (current_level_idx + 1) >= manifest.levels_count;
+        load_level(next_level_idx());
+        if (finished_last) {
             // Finished the last level! Show thank you page!
-            load_level(S8LIT("intro"));
             game->thank_you          = TRUE;
             game->thank_you_duration = 5.0f;
         }
@@ -954,161 +2288,15 @@ FUNCTION void load_next_level()
     }
 }
 
-FUNCTION u8 mix_colors(u8 cur, u8 src)
-{
-    if (cur == Color_WHITE)
-        return src;
-    else if (src == Color_WHITE)
-        return cur;
-    else if (cur == src)
-        return src;
-    
-    // primary-primary.
-    else if ((cur == Color_RED && src == Color_GREEN) || (src == Color_RED && cur == Color_GREEN))
-        return Color_YELLOW;
-    else if ((cur == Color_RED && src == Color_BLUE) || (src == Color_RED && cur == Color_BLUE))
-        return Color_MAGENTA;
-    else if ((cur == Color_GREEN && src == Color_BLUE) || (src == Color_GREEN && cur == Color_BLUE))
-        return Color_CYAN;
-    
-    // secondary-secondary.
-    else if ((cur == Color_YELLOW && src == Color_MAGENTA) || (src == Color_YELLOW && cur == Color_MAGENTA))
-        return Color_RED;
-    else if ((cur == Color_YELLOW && src == Color_CYAN) || (src == Color_YELLOW && cur == Color_CYAN))
-        return Color_GREEN;
-    else if ((cur == Color_MAGENTA && src == Color_CYAN) || (src == Color_MAGENTA && cur == Color_CYAN))
-        return Color_BLUE;
-    
-    // primary-secondary.
-    else if ((cur == Color_YELLOW && ((src == Color_RED) || (src == Color_GREEN))) || (src == Color_YELLOW && ((cur == Color_RED) || (cur == Color_GREEN))))
-        return Color_YELLOW;
-    else if ((cur == Color_MAGENTA && ((src == Color_RED) || (src == Color_BLUE))) || (src == Color_MAGENTA && ((cur == Color_RED) || (cur == Color_BLUE))))
-        return Color_MAGENTA;
-    else if ((cur == Color_CYAN && ((src == Color_GREEN) || (src == Color_BLUE))) || (src == Color_CYAN && ((cur == Color_GREEN) || (cur == Color_BLUE))))
-        return Color_CYAN;
-    
-    else
-        return Color_WHITE;
-}
-
-FUNCTION void update_beams(s32 src_x, s32 src_y, u8 src_dir, u8 src_color)
-{
-    if (is_outside_map(src_x + dirs[src_dir].x, src_y + dirs[src_dir].y))
-        return;
-    
-    s32 test_x = src_x + dirs[src_dir].x;
-    s32 test_y = src_y + dirs[src_dir].y;
-    Obj test_o = objmap[test_y][test_x];
-    
-    b32 is_obj_aligned = (((src_x == pushed_obj.x) && (src_x == pushed_obj_pos.x)) || 
-                          ((src_y == pushed_obj.y) && (src_y == pushed_obj_pos.y)));
-    
-    // Advance until we hit a wall or an object.
-    while ((test_o.type == T_EMPTY || test_o.type == T_DOOR_OPEN) && tilemap[test_y][test_x] != Tile_WALL) {
-        
-        // We hit the player.
-        if (test_x == px && test_y == py)
-            pcolor = mix_colors(pcolor, src_color);
-        
-        if (is_outside_map(test_x + dirs[src_dir].x, test_y + dirs[src_dir].y))
-            return;
-        test_x += dirs[src_dir].x;
-        test_y += dirs[src_dir].y;
-        test_o  = objmap[test_y][test_x];
-    }
-    if (tilemap[test_y][test_x] == Tile_WALL) 
-        return;
-    
-    // In case player is standing on some Obj like T_DETECTOR.
-    if (test_x == px && test_y == py) {
-        pcolor = mix_colors(pcolor, src_color);
-    }
-    
-    b32 is_pushed_obj  = ((test_x == pushed_obj.x) && (test_y == pushed_obj.y));
-    
-    // We hit an object, so we should determine which color to reflect in which dir.  
-    switch (test_o.type) {
-        case T_DOOR:
-        case T_LASER: {
-        } break;
-        case T_MIRROR:
-        case T_BENDER:
-        case T_SPLITTER: {
-            u8 inv_d       = WRAP_D(src_dir + 4);
-            u8 ninv_d      = WRAP_D(inv_d + 1);
-            u8 pinv_d      = WRAP_D(inv_d - 1 );
-            u8 p2inv_d     = WRAP_D(inv_d - 2);
-            u8 reflected_d = U8_MAX;
-            b32 penetrate  = TRUE;
-            
-            if (test_o.type == T_MIRROR) {
-                if      (test_o.dir == inv_d)  reflected_d = inv_d;
-                else if (test_o.dir == ninv_d) reflected_d = WRAP_D(ninv_d + 1);
-                else if (test_o.dir == pinv_d) reflected_d = WRAP_D(pinv_d - 1);
-                
-                // Write the color if not already written AND direction is valid.
-                if ((reflected_d != U8_MAX) && (src_color != test_o.color[reflected_d])) {
-                    objmap[test_y][test_x].color[reflected_d] = mix_colors(test_o.color[reflected_d], src_color);
-                    update_beams(test_x, test_y, reflected_d, objmap[test_y][test_x].color[reflected_d]);
-                }
-            } else if (test_o.type == T_BENDER) {
-                if      (test_o.dir == inv_d)   reflected_d = ninv_d;
-                else if (test_o.dir == ninv_d)  reflected_d = WRAP_D(ninv_d + 2);
-                else if (test_o.dir == pinv_d)  reflected_d = pinv_d;
-                else if (test_o.dir == p2inv_d) reflected_d = WRAP_D(p2inv_d - 1);
-                
-                // Write the color if not already written AND direction is valid.
-                if ((reflected_d != U8_MAX) && (src_color != test_o.color[reflected_d])) {
-                    objmap[test_y][test_x].color[reflected_d] = mix_colors(test_o.color[reflected_d], src_color);
-                    update_beams(test_x, test_y, reflected_d, objmap[test_y][test_x].color[reflected_d]);
-                }
-            } else {
-                if (test_o.dir == inv_d || test_o.dir == src_dir)
-                    penetrate = TRUE;
-                else if (test_o.dir == ninv_d || test_o.dir == WRAP_D(src_dir + 1))
-                    reflected_d = WRAP_D(ninv_d + 1);
-                else if (test_o.dir == pinv_d || test_o.dir == WRAP_D(src_dir - 1))
-                    reflected_d = WRAP_D(pinv_d - 1);
-                else 
-                    penetrate = FALSE;
-                
-                // Source direction.
-                //
-                if (penetrate) {
-                    u8 c = test_o.c == Color_WHITE? mix_colors(test_o.color[src_dir], src_color) : test_o.c;
-                    objmap[test_y][test_x].color[src_dir] = c;
-                    update_beams(test_x, test_y, src_dir, c);
-                }
-                
-                // Reflected direction.
-                //
-                // Write the color if not already written AND direction is valid.
-                if ((reflected_d != U8_MAX) && (src_color != test_o.color[reflected_d])) {
-                    u8 c = test_o.c == Color_WHITE? mix_colors(test_o.color[reflected_d], src_color) : test_o.c;
-                    objmap[test_y][test_x].color[reflected_d] = c;
-                    update_beams(test_x, test_y, reflected_d, c);
-                }
-            }
-        } break;
-        case T_DETECTOR: {
-            // Write the color if not already written.
-            if (src_color != test_o.color[src_dir]) {
-                objmap[test_y][test_x].color[src_dir] = mix_colors(test_o.color[src_dir], src_color);
-                update_beams(test_x, test_y, src_dir, objmap[test_y][test_x].color[src_dir]);
-            }
-        } break;
-    }
-}
-
 FUNCTION b32 player_collides(s32 x, s32 y)
 {
     // Return whether players collide with whatever's on [x,y].
     
     // @Todo: Add player pos? Multiple players should collide with one another.
     b32 result = ((is_outside_map(x, y))             ||
-                  (tilemap[y][x]     == Tile_WALL)   ||
-                  (objmap[y][x].type == T_LASER)     ||
-                  (objmap[y][x].type == T_DOOR));
+                  (tilemap[MAP_IDX(x, y)]     == Tile_WALL)   ||
+                  (objmap.type[MAP_IDX(x, y)] == T_LASER)     ||
+                  (objmap.type[MAP_IDX(x, y)] == T_DOOR));
     return result;
 }
 
@@ -1118,15 +2306,15 @@ FUNCTION b32 obj_collides(s32 x, s32 y)
     
     // @Todo: Add player pos? Multiple players should collide with one another.
     b32 result = ((is_outside_map(x, y))              ||
-                  (tilemap[y][x]     == Tile_WALL)    ||
-                  (objmap[y][x].type == T_LASER)      ||
-                  (objmap[y][x].type == T_MIRROR)     ||
-                  (objmap[y][x].type == T_BENDER)     ||
-                  (objmap[y][x].type == T_SPLITTER)   ||
-                  (objmap[y][x].type == T_DETECTOR)   ||
-                  (objmap[y][x].type == T_DOOR)       ||
-                  (objmap[y][x].type == T_DOOR_OPEN)  ||
-                  (objmap[y][x].type == T_TELEPORTER));
+                  (tilemap[MAP_IDX(x, y)]     == Tile_WALL)    ||
+                  (objmap.type[MAP_IDX(x, y)] == T_LASER)      ||
+                  (objmap.type[MAP_IDX(x, y)] == T_MIRROR)     ||
+                  (objmap.type[MAP_IDX(x, y)] == T_BENDER)     ||
+                  (objmap.type[MAP_IDX(x, y)] == T_SPLITTER)   ||
+                  (objmap.type[MAP_IDX(x, y)] == T_DETECTOR)   ||
+                  (objmap.type[MAP_IDX(x, y)] == T_DOOR)       ||
+                  (objmap.type[MAP_IDX(x, y)] == T_DOOR_OPEN)  ||
+                  (objmap.type[MAP_IDX(x, y)] == T_TELEPORTER));
     return result;
 }
 
@@ -1142,14 +2330,19 @@ FUNCTION b32 move_obj(s32 x, s32 y, s32 dir_x, s32 dir_y)
     
     // Commit move.
     undo_push_obj_move(&undo_handler, x, y, newx, newy);
-    SWAP(objmap[y][x], objmap[newy][newx], Obj);
+    swap_objs(&objmap, MAP_IDX(x, y), MAP_IDX(newx, newy));
+    obj_index_swap(&obj_index, x, y, newx, newy);
+    beams_mark_dirty(&beam_tracer, x, y);
+    beams_mark_dirty(&beam_tracer, newx, newy);
     pushed_obj     = v2((f32)newx, (f32)newy);
     pushed_obj_pos = v2((f32)x, (f32)y);
     return TRUE;
 }
 
-FUNCTION b32 move_player(s32 dir_x, s32 dir_y)
+FUNCTION b32 move_player(s32 dir_x, s32 dir_y, b32 *pushed = 0)
 {
+    // @Note: Only the rules; the caller plays sounds and emits particles.
+    //
     if (!dir_x && !dir_y) return FALSE;
     u8 old_dir = pdir;
     pdir       = dir_x? dir_x<0? (u8)Dir_W : (u8)Dir_E : dir_y<0? (u8)Dir_S : (u8)Dir_N;
@@ -1160,23 +2353,56 @@ FUNCTION b32 move_player(s32 dir_x, s32 dir_y)
         return FALSE;
     
     // Push obj.
-    b32 pushable = ((objmap[newy][newx].type == T_MIRROR)   ||
-                    (objmap[newy][newx].type == T_BENDER)   ||
-                    (objmap[newy][newx].type == T_SPLITTER));
+    b32 pushable = ((objmap.type[MAP_IDX(newx, newy)] == T_MIRROR)   ||
+                    (objmap.type[MAP_IDX(newx, newy)] == T_BENDER)   ||
+                    (objmap.type[MAP_IDX(newx, newy)] == T_SPLITTER));
     if (pushable) {
-        if (move_obj(newx, newy, dir_x, dir_y))
-            play_sound(&game->sound_manager, S8LIT("object_push"));
-        else
+        if (!move_obj(newx, newy, dir_x, dir_y))
             return FALSE;
+        if (pushed) *pushed = TRUE;
     }
     
     // Commit move.
     undo_push_player_move(&undo_handler, px, py, old_dir);
     set_player_position(newx, newy, pdir);
-    obj_emitter_emit(5, ParticleType_WALK, SLOT3, ppos);
     return TRUE;
 }
 
+FUNCTION s32 rotate_objs_around_player(b32 ccw)
+{
+    // Rotates every rotatable obj in the 8 squares around the player, respecting its flags.
+    // Returns how many turned.
+    //
+    s32 result = 0;
+    for (s32 dy = CLAMP_LOWER(py-1, 0); dy <= CLAMP_UPPER(NUM_Y*SIZE_Y-1, py+1); dy++) {
+        for (s32 dx = CLAMP_LOWER(px-1, 0); dx <= CLAMP_UPPER(NUM_X*SIZE_X-1, px+1); dx++) {
+            if (dy == py && dx == px)
+                continue;
+            
+            s32 i = MAP_IDX(dx, dy);
+            u8 t  = objmap.type[i];
+            if ((t != T_MIRROR && t != T_BENDER && t != T_SPLITTER) || is_set(objmap.flags[i], ObjFlags_NEVER_ROTATE))
+                continue;
+            
+            undo_push_obj_rotate(&undo_handler, dx, dy, objmap.dir[i]);
+            if (ccw) {
+                if (is_set(objmap.flags[i], ObjFlags_ONLY_ROTATE_CW))
+                    objmap.dir[i] = WRAP_D(objmap.dir[i] - 1);
+                else
+                    objmap.dir[i] = WRAP_D(objmap.dir[i] + 1);
+            } else {
+                if (is_set(objmap.flags[i], ObjFlags_ONLY_ROTATE_CCW))
+                    objmap.dir[i] = WRAP_D(objmap.dir[i] + 1);
+                else
+                    objmap.dir[i] = WRAP_D(objmap.dir[i] - 1);
+            }
+            beams_mark_dirty(&beam_tracer, dx, dy);
+            result++;
+        }
+    }
+    return result;
+}
+
 FUNCTION void update_world()
 {
     ////////////////////////////////
@@ -1227,13 +2453,25 @@ FUNCTION void update_world()
         }
     }
     
+    if (input_pressed(REDO)) {
+        if (undo_redo(&undo_handler))
+            play_sound(&game->sound_manager, S8LIT("undo"));
+        
+        // @Hardcoded:
+        dead = FALSE;
+        dead_timer = 0.0f;
+    }
+    
     // Load new level if we step on teleporter.
     if (player_is_at_rest() && !is_teleporting) {
-        Obj o = objmap[py][px];
+        Obj o = get_obj(&objmap, MAP_IDX(px, py));
         if (o.type == T_TELEPORTER) {
             teleport_transition_timer = LEVEL_TRANSITION_DURATION;
             is_teleporting            = TRUE;
             play_sound(&game->sound_manager, S8LIT("teleport"));
+            
+            // Get the next level ready while the transition plays.
+            prefetch_level(next_level_idx());
         }
     }
     if (is_teleporting) {
@@ -1245,16 +2483,14 @@ FUNCTION void update_world()
     ppos = move_towards(ppos, v2((f32)px, (f32)py), player_max_distance);
     
     // Update pushed obj pos.
-    for (s32 y = 0; y < NUM_Y*SIZE_Y; y++) {
-        for (s32 x = 0; x < NUM_X*SIZE_X; x++) {
-            Obj o = objmap[y][x];
-            if (o.type == T_MIRROR ||
-                o.type == T_BENDER ||
-                o.type == T_SPLITTER) {
-                if (pushed_obj.x == x && pushed_obj.y == y) {
-                    pushed_obj_pos = move_towards(pushed_obj_pos, pushed_obj, player_max_distance);
-                }
-            }
+    {
+        s32 x = (s32)pushed_obj.x;
+        s32 y = (s32)pushed_obj.y;
+        if (!is_outside_map(x, y) && 
+            (objmap.type[MAP_IDX(x, y)] == T_MIRROR ||
+             objmap.type[MAP_IDX(x, y)] == T_BENDER ||
+             objmap.type[MAP_IDX(x, y)] == T_SPLITTER)) {
+            pushed_obj_pos = move_towards(pushed_obj_pos, pushed_obj, player_max_distance);
         }
     }
     
@@ -1342,46 +2578,43 @@ FUNCTION void update_world()
                 queued_moves[i] = queued_moves[i+1];
             queued_moves_count--;
             
-            if (move_player(queued_move.x, queued_move.y))
+            b32 pushed = FALSE;
+            if (move_player(queued_move.x, queued_move.y, &pushed)) {
+                if (pushed)
+                    play_sound(&game->sound_manager, S8LIT("object_push"));
                 play_sound(&game->sound_manager, S8LIT("move"));
+                obj_emitter_emit(5, ParticleType_WALK, SLOT3, ppos);
+            }
         }
         
         // Rotate objs around player.
+        s32 rotated = 0;
+        if (input_pressed(ROTATE_CCW))
+            rotated = rotate_objs_around_player(TRUE);
+        else if (input_pressed(ROTATE_CW))
+            rotated = rotate_objs_around_player(FALSE);
+        if (rotated)
+            play_sound(&game->sound_manager, S8LIT("rotate"));
+        
+        // Rotation particles.
         for (s32 dy = CLAMP_LOWER(py-1, 0); dy <= CLAMP_UPPER(NUM_Y*SIZE_Y-1, py+1); dy++) {
             for (s32 dx = CLAMP_LOWER(px-1, 0); dx <= CLAMP_UPPER(NUM_X*SIZE_X-1, px+1); dx++) {
                 if (dy == py && dx == px)
                     continue;
                 
-                switch (objmap[dy][dx].type) {
+                switch (objmap.type[MAP_IDX(dx, dy)]) {
                     case T_MIRROR:
                     case T_BENDER:
                     case T_SPLITTER: {
-                        if (is_set(objmap[dy][dx].flags, ObjFlags_NEVER_ROTATE)) 
+                        if (is_set(objmap.flags[MAP_IDX(dx, dy)], ObjFlags_NEVER_ROTATE)) 
                             continue;
                         
-                        // Perform rotation.
-                        if (input_pressed(ROTATE_CCW)) {
-                            undo_push_obj_rotate(&undo_handler, dx, dy, objmap[dy][dx].dir);
-                            play_sound(&game->sound_manager, S8LIT("rotate"));
-                            if (is_set(objmap[dy][dx].flags, ObjFlags_ONLY_ROTATE_CW))
-                                objmap[dy][dx].dir = WRAP_D(objmap[dy][dx].dir - 1);
-                            else
-                                objmap[dy][dx].dir = WRAP_D(objmap[dy][dx].dir + 1);
-                        } else if (input_pressed(ROTATE_CW)) {
-                            undo_push_obj_rotate(&undo_handler, dx, dy, objmap[dy][dx].dir);
-                            play_sound(&game->sound_manager, S8LIT("rotate"));
-                            if (is_set(objmap[dy][dx].flags, ObjFlags_ONLY_ROTATE_CCW))
-                                objmap[dy][dx].dir = WRAP_D(objmap[dy][dx].dir + 1);
-                            else
-                                objmap[dy][dx].dir = WRAP_D(objmap[dy][dx].dir - 1);
-                        }
-                        
                         V2 pos = ((dx == pushed_obj.x) && (dy == pushed_obj.y))? pushed_obj_pos : v2((f32)dx, (f32)dy);
                         
                         Emitter_Texture_Slot slot = SLOT0;
-                        if (is_set(objmap[dy][dx].flags, ObjFlags_ONLY_ROTATE_CCW))
+                        if (is_set(objmap.flags[MAP_IDX(dx, dy)], ObjFlags_ONLY_ROTATE_CCW))
                             slot = SLOT1;
-                        else if (is_set(objmap[dy][dx].flags, ObjFlags_ONLY_ROTATE_CW))
+                        else if (is_set(objmap.flags[MAP_IDX(dx, dy)], ObjFlags_ONLY_ROTATE_CW))
                             slot = SLOT2;
                         
                         // Add particles every `interval` seconds.
@@ -1400,35 +2633,13 @@ FUNCTION void update_world()
     ////////////////////////////////
     // Update map.
     //
+    obj_index_update(&obj_index);
     
-    // Clear colors for all objs (except ones that use it specially).
-    for (s32 y = 0; y < NUM_Y*SIZE_Y; y++) {
-        for (s32 x = 0; x < NUM_X*SIZE_X; x++) {
-            if (objmap[y][x].type == T_DOOR || objmap[y][x].type == T_DOOR_OPEN)
-                objmap[y][x].color[1] = 0;
-            else
-                MEMORY_ZERO_ARRAY(objmap[y][x].color);
-        }
-    }
-    pcolor = Color_WHITE;
-    
-    // Update beams (do red lasers first).
-    for (s32 y = 0; y < NUM_Y*SIZE_Y; y++) {
-        for (s32 x = 0; x < NUM_X*SIZE_X; x++) {
-            Obj o = objmap[y][x];
-            if ((o.type == T_LASER) && (o.c == Color_RED))
-                update_beams(x, y, o.dir, o.c);
-        }
-    }
-    for (s32 y = 0; y < NUM_Y*SIZE_Y; y++) {
-        for (s32 x = 0; x < NUM_X*SIZE_X; x++) {
-            Obj o = objmap[y][x];
-            if ((o.type == T_LASER) && (o.c != Color_RED))
-                update_beams(x, y, o.dir, o.c);
-        }
-    }
+    // Update beams. Only the ones going through something that changed are retraced.
+    beams_update(&beam_tracer);
     
-    if (pcolor == Color_RED || pcolor == Color_MAGENTA || pcolor == Color_YELLOW) {
+    // Anything with red in it kills the player.
+    if (pcolor & Color_RED) {
         if (!dead)
             play_sound(&game->sound_manager, S8LIT("death"));
         dead = TRUE;
@@ -1437,46 +2648,12 @@ FUNCTION void update_world()
         dead = FALSE;
     
     // Update doors and detectors.
-    for (s32 y = 0; y < NUM_Y*SIZE_Y; y++) {
-        for (s32 x = 0; x < NUM_X*SIZE_X; x++) {
-            Obj detector = objmap[y][x];
-            if (detector.type == T_DETECTOR) {
-                s32 room_x = SIZE_X*(x/SIZE_X);
-                s32 room_y = SIZE_Y*(y/SIZE_Y);
-                
-                u8 final_c = Color_WHITE;
-                for (s32 i = 0; i < 8; i++)
-                    final_c = mix_colors(final_c, detector.color[i]);
-                
-                for (s32 dy = room_y; dy < room_y+SIZE_Y; dy++) {
-                    for (s32 dx = room_x; dx < room_x+SIZE_X; dx++) {
-                        if (dx == x && dy == y)
-                            continue;
-                        if ((objmap[dy][dx].type == T_DOOR || objmap[dy][dx].type == T_DOOR_OPEN) && objmap[dy][dx].c == detector.c) {
-                            if (final_c == detector.c) {
-                                // Potentially open door.
-                                objmap[dy][dx].color[1] += 1;
-                                if (objmap[dy][dx].color[1] >= objmap[dy][dx].color[0]) {
-                                    if (objmap[dy][dx].type == T_DOOR)
-                                        play_sound(&game->sound_manager, S8LIT("door_open"));
-                                    objmap[dy][dx].type = T_DOOR_OPEN;
-                                }
-                                //else
-                                //objmap[dy][dx].type = T_DOOR;
-                            } else {
-                                // Close door.
-                                if (objmap[dy][dx].color[1] < objmap[dy][dx].color[0]) {
-                                    if (objmap[dy][dx].type == T_DOOR_OPEN)
-                                        play_sound(&game->sound_manager, S8LIT("door_close"));
-                                    objmap[dy][dx].type = T_DOOR;
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-        }
-    }
+    b32 door_opened = FALSE, door_closed = FALSE;
+    door_index_update(&door_index, &door_opened, &door_closed);
+    if (door_opened)
+        play_sound(&game->sound_manager, S8LIT("door_open"));
+    if (door_closed)
+        play_sound(&game->sound_manager, S8LIT("door_close"));
     
     obj_emitter_update_particles();
 }
@@ -1524,36 +2701,36 @@ FUNCTION void update_editor()
     if (!mouse_over_ui()) {
         if (key_held(Key_MLEFT)) {
             if (game->is_tile_selected) {
-                if ((game->selected_tile_or_obj == Tile_WALL) && (objmap[my][mx].type != T_EMPTY));
+                if ((game->selected_tile_or_obj == Tile_WALL) && (objmap.type[MAP_IDX(mx, my)] != T_EMPTY));
                 else
-                    tilemap[my][mx] = game->selected_tile_or_obj;
+                    tilemap[MAP_IDX(mx, my)] = game->selected_tile_or_obj;
             } else {
-                if (tilemap[my][mx] != Tile_WALL) {
-                    objmap[my][mx].type = game->selected_tile_or_obj;
+                if (tilemap[MAP_IDX(mx, my)] != Tile_WALL) {
+                    objmap.type[MAP_IDX(mx, my)] = game->selected_tile_or_obj;
                     
                     if (game->selected_tile_or_obj == T_LASER   || 
                         game->selected_tile_or_obj == T_DETECTOR  ||
                         game->selected_tile_or_obj == T_DOOR      ||
                         game->selected_tile_or_obj == T_DOOR_OPEN ||
                         game->selected_tile_or_obj == T_SPLITTER)
-                        objmap[my][mx].c = (u8)game->selected_color;
+                        objmap.c[MAP_IDX(mx, my)] = (u8)game->selected_color;
                     
-                    if (objmap[my][mx].flags == ObjFlags_NONE) {
-                        objmap[my][mx].flags = (u8)game->selected_flag;
+                    if (objmap.flags[MAP_IDX(mx, my)] == ObjFlags_NONE) {
+                        objmap.flags[MAP_IDX(mx, my)] = (u8)game->selected_flag;
                         game->selected_flag = 0;
                     }
                     
                     if (game->selected_tile_or_obj == T_DOOR) {
-                        objmap[my][mx].color[0] = (u8)game->num_detectors_required;
+                        objmap.color[MAP_IDX(mx, my)*8 + 0] = (u8)game->num_detectors_required;
                     }
                 }
             }
         }
         if (key_held(Key_MRIGHT)) {
             if (game->is_tile_selected) {
-                tilemap[my][mx] = Tile_FLOOR;
+                tilemap[MAP_IDX(mx, my)] = Tile_FLOOR;
             } else {
-                objmap[my][mx] = {};
+                set_obj(&objmap, MAP_IDX(mx, my), {});
             }
         }
         
@@ -1571,11 +2748,18 @@ FUNCTION void update_editor()
     //
     if (!key_held(Key_SHIFT)) {
         if (os->mouse_scroll.y > 0) {
-            objmap[my][mx].dir = WRAP_D(objmap[my][mx].dir + (s32)os->mouse_scroll.y);
+            objmap.dir[MAP_IDX(mx, my)] = WRAP_D(objmap.dir[MAP_IDX(mx, my)] + (s32)os->mouse_scroll.y);
         } else if (os->mouse_scroll.y < 0) {
-            objmap[my][mx].dir = WRAP_D(objmap[my][mx].dir + (s32)os->mouse_scroll.y);
+            objmap.dir[MAP_IDX(mx, my)] = WRAP_D(objmap.dir[MAP_IDX(mx, my)] + (s32)os->mouse_scroll.y);
         }
     }
+    
+    // The editor can change anything, so reindex objs and doors and retrace all beams.
+    obj_index.rebuild = TRUE;
+    obj_index_update(&obj_index);
+    beams_mark_all_dirty(&beam_tracer);
+    beams_update(&beam_tracer);
+    door_index.rebuild = TRUE;
 }
 #endif
 
@@ -1886,6 +3070,8 @@ FUNCTION void update_menus()
     }
 }
 
+#include "replay.h"
+
 FUNCTION void game_update()
 {
     game->delta_mouse   = os->mouse_ndc.xy - game->mouse_ndc_old;
@@ -1925,8 +3111,29 @@ FUNCTION void game_update()
         PLAYER_ANIMATION_SPEED = CLAMP_UPPER(20.0f, PLAYER_ANIMATION_SPEED + 1.0f);
         print("Animation speed: %f\n", PLAYER_ANIMATION_SPEED);
     }
+    
+    // F9 starts/stops recording the current level, F10 plays the last recording back.
+    if (key_pressed(Key_F9) && replay.mode != ReplayMode_PLAYING) {
+        Arena_Temp scratch = get_scratch(0, 0);
+        if (replay.mode == ReplayMode_RECORDING)
+            replay_end_recording(sprint(scratch.arena, "%Slast_replay.rec", os->data_folder));
+        else if (current_mode == M_GAME)
+            replay_begin_recording();
+        free_scratch(scratch);
+    }
+    if (key_pressed(Key_F10) && replay.mode == ReplayMode_NONE) {
+        Arena_Temp scratch = get_scratch(0, 0);
+        os->wait_for_file_writes();
+        if (replay_load(sprint(scratch.arena, "%Slast_replay.rec", os->data_folder)))
+            replay_begin_playback();
+        free_scratch(scratch);
+    }
 #endif
     
+    // @Note: Hotkeys above always see the real input; from here on it may be a replay's.
+    replay_begin_tick();
+    defer(replay_end_tick());
+    
     // Update thank you page timer.
     if (game->thank_you) {
         game->thank_you_duration -= os->dt;
@@ -2028,133 +3235,68 @@ FUNCTION void draw_line(s32 src_x, s32 src_y, s32 dst_x, s32 dst_y, V4 *color, f
     draw_line(start, end, color, a);
 }
 
-FUNCTION void draw_beams(s32 src_x, s32 src_y, u8 src_dir, u8 src_color)
+FUNCTION void draw_beams(Beam_Tracer *tracer)
 {
-    V2 src_pos = {(f32)src_x, (f32)src_y};
-    
-    if (is_outside_map(src_x + dirs[src_dir].x, src_y + dirs[src_dir].y)) {
-        V2 edge = src_pos + 0.5f*fdirs[src_dir];
-        draw_line(src_pos, edge, &colors[src_color], 1.0f);
-        return;
-    }
-    
-    u32 func_id = 0;
-    func_id |= (src_x     & 0xFF) << 24;
-    func_id |= (src_y     & 0xFF) << 16;
-    func_id |= (src_dir   & 0xFF) << 8; 
-    func_id |= (src_color & 0xFF);
-    if (array_find_index(&unique_draw_beams_calls, func_id) != -1) {
-        // @Note: Started looping.
-        return;
-    } else {
-        array_add(&unique_draw_beams_calls, func_id);
-    }
-    
-    s32 test_x  = src_x + dirs[src_dir].x;
-    s32 test_y  = src_y + dirs[src_dir].y;
-    Obj test_o  = objmap[test_y][test_x];
-    V2 test_pos = {(f32)test_x, (f32)test_y};
-    
-    b32 is_obj_aligned = (((src_x == pushed_obj.x) && (src_x == pushed_obj_pos.x)) || 
-                          ((src_y == pushed_obj.y) && (src_y == pushed_obj_pos.y)));
-    
-    // Advance until we hit a wall or an object.
-    while ((test_o.type == T_EMPTY || test_o.type == T_DOOR_OPEN) &&
-           tilemap[test_y][test_x] != Tile_WALL) { 
-        
-        // We hit the player.
-        if (test_x == px && test_y == py) {
-        }
-        
-        if (is_outside_map(test_x + dirs[src_dir].x, test_y + dirs[src_dir].y)) {
-            V2 edge = test_pos + 0.5f*fdirs[src_dir];
-            draw_line(src_pos, edge, &colors[src_color], 1.0f);
-            return;
-        }
-        
-        test_x  += dirs[src_dir].x;
-        test_y  += dirs[src_dir].y;
-        test_o   = objmap[test_y][test_x];
-        test_pos = {(f32)test_x, (f32)test_y};
-    }
-    if (tilemap[test_y][test_x] == Tile_WALL) {
-        draw_line(src_x, src_y, test_x, test_y, &colors[src_color], 1.0f);
-        return;
-    }
-    
-    b32 is_pushed_obj = ((test_x == pushed_obj.x) && (test_y == pushed_obj.y));
-    
-    // We hit an object, so we should determine which color to draw in which dir.  
-    switch (test_o.type) {
-        case T_DOOR: {
-            draw_line(src_x, src_y, test_x, test_y, &colors[src_color], 1.0f);
-        } break;
-        case T_LASER: {
-            u8 c = (test_o.dir == WRAP_D(src_dir + 4))? mix_colors(test_o.c, src_color) : src_color;
-            draw_line(src_x, src_y, test_x, test_y, &colors[c], 1.0f);
-        } break;
-        case T_MIRROR: 
-        case T_BENDER:
-        case T_SPLITTER: {
-            u8 inv_d       = WRAP_D(src_dir + 4);
-            u8 ninv_d      = WRAP_D(inv_d + 1);
-            u8 pinv_d      = WRAP_D(inv_d - 1);
-            u8 p2inv_d     = WRAP_D(inv_d - 2);
-            u8 reflected_d = U8_MAX;
-            b32 penetrate  = TRUE;
-            
-            u8 c = mix_colors(test_o.color[inv_d], src_color);
-            
-            draw_line(src_x, src_y, test_x, test_y, &colors[c], 1.0f);
-            
-            if (test_o.type == T_MIRROR) {
-                if      (test_o.dir == inv_d)  reflected_d = inv_d;
-                else if (test_o.dir == ninv_d) reflected_d = WRAP_D(ninv_d + 1);
-                else if (test_o.dir == pinv_d) reflected_d = WRAP_D(pinv_d - 1);
-                
-                if (reflected_d != U8_MAX)
-                    draw_beams(test_x, test_y, reflected_d, test_o.color[reflected_d]);
-            } else if (test_o.type == T_BENDER) {
-                if      (test_o.dir == inv_d)   reflected_d = ninv_d;
-                else if (test_o.dir == ninv_d)  reflected_d = WRAP_D(ninv_d + 2);
-                else if (test_o.dir == pinv_d)  reflected_d = pinv_d;
-                else if (test_o.dir == p2inv_d) reflected_d = WRAP_D(p2inv_d - 1);
+    // @Note: We draw the segments the last retrace left behind instead of tracing again. Objs can
+    // emit several segments in the same dir while colors mix; only the one with the obj's final
+    // color is drawn.
+    //
+    for (s32 l = 0; l < tracer->lasers_count; l++) {
+        for (s32 square = tracer->lasers[l].first_square; square >= 0; square = tracer->next[square]) {
+            for (s32 i = tracer->first_segment[square]; i >= 0; i = tracer->segments[i].next) {
+                Beam_Segment segment = tracer->segments[i];
+                s32 src_x     = segment.x;
+                s32 src_y     = segment.y;
+                u8 src_dir    = segment.dir;
+                u8 src_color  = segment.color;
+                Obj src_o     = get_obj(&objmap, MAP_IDX(src_x, src_y));
+                u8 final_c    = src_o.type == T_LASER? src_o.c : src_o.color[src_dir];
+                if (src_color != final_c)
+                    continue;
                 
-                if (reflected_d != U8_MAX)
-                    draw_beams(test_x, test_y, reflected_d, test_o.color[reflected_d]);
-            } else {
-                if (test_o.dir == inv_d || test_o.dir == src_dir)
-                    penetrate = TRUE;
-                else if (test_o.dir == ninv_d || test_o.dir == WRAP_D(src_dir + 1))
-                    reflected_d = WRAP_D(ninv_d + 1);
-                else if (test_o.dir == pinv_d || test_o.dir == WRAP_D(src_dir - 1))
-                    reflected_d = WRAP_D(pinv_d - 1);
-                else
-                    penetrate = FALSE;
+                s32 k      = tracer->jump[(src_y*tracer->width + src_x)*8 + src_dir];
+                s32 test_x = src_x + k*dirs[src_dir].x;
+                s32 test_y = src_y + k*dirs[src_dir].y;
+                if (is_outside_map(test_x, test_y)) {
+                    V2 edge = v2((f32)(test_x - dirs[src_dir].x), (f32)(test_y - dirs[src_dir].y)) + 0.5f*fdirs[src_dir];
+                    draw_line(v2((f32)src_x, (f32)src_y), edge, &colors[src_color], 1.0f);
+                    continue;
+                }
                 
-                if (penetrate)
-                    draw_beams(test_x, test_y, src_dir, test_o.color[src_dir]);
-                if (reflected_d != U8_MAX)
-                    draw_beams(test_x, test_y, reflected_d, test_o.color[reflected_d]);
+                // Color the segment by what it hit.
+                u8 c       = src_color;
+                Obj test_o = get_obj(&objmap, MAP_IDX(test_x, test_y));
+                if (tilemap[MAP_IDX(test_x, test_y)] != Tile_WALL) {
+                    u8 inv_d = WRAP_D(src_dir + 4);
+                    switch (test_o.type) {
+                        case T_LASER: {
+                            if (test_o.dir == inv_d)
+                                c = mix_colors(test_o.c, src_color);
+                        } break;
+                        case T_MIRROR:
+                        case T_BENDER:
+                        case T_SPLITTER:
+                        case T_DETECTOR: {
+                            c = mix_colors(test_o.color[inv_d], src_color);
+                        } break;
+                    }
+                }
+                draw_line(src_x, src_y, test_x, test_y, &colors[c], 1.0f);
             }
-        } break;
-        case T_DETECTOR: {
-            u8 inv_d  = WRAP_D(src_dir + 4);
-            u8 c = mix_colors(test_o.color[inv_d], src_color);
-            draw_line(src_x, src_y, test_x, test_y, &colors[c], 1.0f);
-            draw_beams(test_x, test_y, src_dir, test_o.color[src_dir]);
-        } break;
+        }
     }
 }
 
 FUNCTION void draw_world()
 {
+    obj_index_update(&obj_index);
+    
     immediate_begin();
     set_texture(&tex);
     // Draw tiles.
     for (s32 y = 0; y < NUM_Y*SIZE_Y; y++) {
         for (s32 x = 0; x < NUM_X*SIZE_X; x++) {
-            u8 t = tilemap[y][x];
+            u8 t = tilemap[MAP_IDX(x, y)];
             // Skip walls, we draw them later.
             if (t == Tile_WALL) continue; 
             
@@ -2174,24 +3316,24 @@ FUNCTION void draw_world()
     immediate_begin();
     set_texture(&tex);
     // Draw detectors.
-    for (s32 y = 0; y < NUM_Y*SIZE_Y; y++) {
-        for (s32 x = 0; x < NUM_X*SIZE_X; x++) {
-            Obj o = objmap[y][x];
-            V2s bg     = tile_sprite[Tile_DETECTOR_BACKGROUND];
-            V2s sprite = obj_sprite[o.type];
-            if (o.type == T_DETECTOR) {
-                u8 final_c = Color_WHITE;
-                for (s32 i = 0; i < 8; i++)
-                    final_c = mix_colors(final_c, o.color[i]);
-                
-                if (final_c == o.c) {
-                    draw_sprite(x, y, 1.2f, 1.2f, bg.s, bg.t, &colors[o.c], 1.0f);
-                    draw_sprite(x, y, 1.2f, 1.2f, sprite.s, sprite.t, 0, 1.0f);
-                } else {
-                    draw_sprite(x, y, 0.8f, 0.8f, bg.s, bg.t, &colors[o.c], 1.0f);
-                    draw_sprite(x, y, 0.8f, 0.8f, sprite.s, sprite.t, 0, 1.0f);
-                }
-            }
+    for (s32 i = 0; i < obj_index.counts[T_DETECTOR]; i++) {
+        V2s p      = obj_index_get(&obj_index, T_DETECTOR, i);
+        s32 x      = p.x;
+        s32 y      = p.y;
+        Obj o      = get_obj(&objmap, MAP_IDX(x, y));
+        V2s bg     = tile_sprite[Tile_DETECTOR_BACKGROUND];
+        V2s sprite = obj_sprite[o.type];
+        
+        u8 final_c = Color_WHITE;
+        for (s32 d = 0; d < 8; d++)
+            final_c = mix_colors(final_c, o.color[d]);
+        
+        if (final_c == o.c) {
+            draw_sprite(x, y, 1.2f, 1.2f, bg.s, bg.t, &colors[o.c], 1.0f);
+            draw_sprite(x, y, 1.2f, 1.2f, sprite.s, sprite.t, 0, 1.0f);
+        } else {
+            draw_sprite(x, y, 0.8f, 0.8f, bg.s, bg.t, &colors[o.c], 1.0f);
+            draw_sprite(x, y, 0.8f, 0.8f, sprite.s, sprite.t, 0, 1.0f);
         }
     }
     immediate_end();
@@ -2199,25 +3341,29 @@ FUNCTION void draw_world()
     immediate_begin();
     set_texture(0);
     // Draw frame backgrounds.
-    for (s32 y = 0; y < NUM_Y*SIZE_Y; y++) {
-        for (s32 x = 0; x < NUM_X*SIZE_X; x++) {
-            Obj o = objmap[y][x];
-            if (o.type == T_LASER) {
-                V4 c = colors[o.c];
-                immediate_rect(v2((f32)x, (f32)y), v2(0.35f), c);
-            } else if (o.type == T_DOOR) {
-                V4 c = colors[o.c];
-                immediate_rect(v2((f32)x, (f32)y), v2(0.45f), c);
-            }
+    for (s32 i = 0; i < obj_index.counts[T_LASER]; i++) {
+        V2s p = obj_index_get(&obj_index, T_LASER, i);
+        V4 c  = colors[objmap.c[MAP_IDX(p.x, p.y)]];
+        immediate_rect(v2((f32)p.x, (f32)p.y), v2(0.35f), c);
+    }
+    for (s32 i = 0; i < obj_index.counts[T_DOOR]; i++) {
+        V2s p = obj_index_get(&obj_index, T_DOOR, i);
+        Obj o = get_obj(&objmap, MAP_IDX(p.x, p.y));
+        if (o.type == T_DOOR) {
+            V4 c = colors[o.c];
+            immediate_rect(v2((f32)p.x, (f32)p.y), v2(0.45f), c);
         }
     }
     immediate_end();
     immediate_begin();
     set_texture(&tex);
     // Draw obj frames.
-    for (s32 y = 0; y < NUM_Y*SIZE_Y; y++) {
-        for (s32 x = 0; x < NUM_X*SIZE_X; x++) {
-            Obj o = objmap[y][x];
+    for (u8 type = T_LASER; type <= T_SPLITTER; type++) {
+        for (s32 i = 0; i < obj_index.counts[type]; i++) {
+            V2s p = obj_index_get(&obj_index, type, i);
+            s32 x = p.x;
+            s32 y = p.y;
+            Obj o = get_obj(&objmap, MAP_IDX(x, y));
             switch (o.type) {
                 case T_LASER: {
                     V2s frame = tile_sprite[Tile_LASER_FRAME];
@@ -2239,22 +3385,14 @@ FUNCTION void draw_world()
     immediate_end();
     
     // Draw laser beams.
-    for (s32 y = 0; y < NUM_Y*SIZE_Y; y++) {
-        for (s32 x = 0; x < NUM_X*SIZE_X; x++) {
-            Obj o = objmap[y][x];
-            if (o.type == T_LASER) {
-                array_reset(&unique_draw_beams_calls);
-                draw_beams(x, y, o.dir, o.c);
-            }
-        }
-    }
+    draw_beams(&beam_tracer);
     
     immediate_begin();
     set_texture(&tex);
     // Draw walls.
     for (s32 y = 0; y < NUM_Y*SIZE_Y; y++) {
         for (s32 x = 0; x < NUM_X*SIZE_X; x++) {
-            u8 t = tilemap[y][x];
+            u8 t = tilemap[MAP_IDX(x, y)];
             if (t == Tile_WALL)
                 draw_sprite(x, y, 1, 1, tile_sprite[t].s, tile_sprite[t].t, 0, 1.0f);
         }
@@ -2264,9 +3402,12 @@ FUNCTION void draw_world()
     immediate_begin();
     set_texture(&tex);
     // Draw objs.
-    for (s32 y = 0; y < NUM_Y*SIZE_Y; y++) {
-        for (s32 x = 0; x < NUM_X*SIZE_X; x++) {
-            Obj o = objmap[y][x];
+    for (u8 type = T_LASER; type < T_COUNT; type++) {
+        for (s32 i = 0; i < obj_index.counts[type]; i++) {
+            V2s p = obj_index_get(&obj_index, type, i);
+            s32 x = p.x;
+            s32 y = p.y;
+            Obj o = get_obj(&objmap, MAP_IDX(x, y));
             V2s sprite = obj_sprite[o.type];
             b32 is_pushed_obj = (pushed_obj.x == x && pushed_obj.y == y);
             switch (o.type) {
@@ -2316,8 +3457,8 @@ FUNCTION void draw_world()
     
     // Draw info/guides.
     {
-        String8 current_level_name = level_names[game->loaded_level.idx];
-        if (current_level_name == S8LIT("intro")) {
+        u32 level_flags = manifest.levels[game->loaded_level.idx].flags;
+        if (level_flags & LevelFlags_INFO_CONTROLS) {
             // Draw controls.
             f32 s = 0.15f * get_width(os->drawing_rect);
             immediate_begin();
@@ -2332,7 +3473,7 @@ FUNCTION void draw_world()
             is_using_pixel_coords = TRUE;
             immediate_rect_tl(v2(0, 0.5f*get_height(os->drawing_rect)), v2(s), v2(0), v2(1), v4(1));
             immediate_end();
-        } else if (current_level_name == S8LIT("primary_mixing_intro")) {
+        } else if (level_flags & LevelFlags_INFO_MIXING) {
             f32 s = 0.18f * get_width(os->drawing_rect);
             immediate_begin();
             set_texture(&game->tex_info_mixing);
@@ -2534,11 +3675,11 @@ FUNCTION void draw_menus()
             p = v2(0.5f*w, 0.3333f*h);
             draw_text(&consolas, p, 5, v4(1), "%d", master_volume);
             p.y += yadvance;
-            draw_text(&consolas, p, 5, draw_grid? v4(0,1,0,1) : v4(1,0,0,1), draw_grid? "T" : "F");
+            draw_text(&consolas, p, 5, draw_grid? v4(0,1,0,1) : v4(1,0,0,1), "%s", draw_grid? "T" : "F");
             p.y += yadvance;
-            draw_text(&consolas, p, 5, os->fullscreen? v4(0,1,0,1) : v4(1,0,0,1), os->fullscreen? "T" : "F");
+            draw_text(&consolas, p, 5, os->fullscreen? v4(0,1,0,1) : v4(1,0,0,1), "%s", os->fullscreen? "T" : "F");
             p.y += yadvance;
-            draw_text(&consolas, p, 5, prompt_user_on_restart? v4(0,1,0,1) : v4(1,0,0,1), prompt_user_on_restart? "T" : "F");
+            draw_text(&consolas, p, 5, prompt_user_on_restart? v4(0,1,0,1) : v4(1,0,0,1), "%s", prompt_user_on_restart? "T" : "F");
         } break;
         case RESTART_CONFIRMATION: {
             if (prompt_user_on_restart == FALSE)
@@ -2581,6 +3722,7 @@ FUNCTION void draw_menus()
                 "WASD/ARROWS               MOVE",
                 "Q E                       ROTATE MIRRORS",
                 "Z                         UNDO",
+                "Y                         REDO",
                 "R                         RESTART LEVEL",
                 "G                         TOGGLE GRID",
                 
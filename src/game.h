@@ -23,6 +23,7 @@ enum Game_Input
     ROTATE_CW,
     
     UNDO,
+    REDO,
     
     PAUSE_MENU,
     BACK,
@@ -50,6 +51,7 @@ GLOBAL Game_Input_Binds binds[] = {
     {{Key_E},                  {GamepadButton_RIGHT_BUMPER}},
     
     {{Key_Z},                  {GamepadButton_Y, GamepadButton_X}},
+    {{Key_Y},                  {}},
     
     {{Key_ESCAPE},             {GamepadButton_START}},
     {{Key_BACKSPACE},          {GamepadButton_B}},
@@ -223,6 +225,8 @@ enum
     T_DOOR,
     T_DOOR_OPEN,
     T_TELEPORTER,
+    
+    T_COUNT,
 };
 
 V2s obj_sprite[] = {
@@ -237,27 +241,60 @@ V2s obj_sprite[] = {
     v2s(2, 0),
 };
 
+// @Note: Colors are RGB bit masks. Color_WHITE means no light at all.
+//
 enum
 {
-    Color_WHITE,
-    Color_RED,
-    Color_GREEN,
-    Color_BLUE,
-    Color_YELLOW,
-    Color_MAGENTA,
-    Color_CYAN,
+    Color_WHITE   = 0,
+    Color_RED     = 1 << 0,
+    Color_GREEN   = 1 << 1,
+    Color_BLUE    = 1 << 2,
+    Color_YELLOW  = Color_RED   | Color_GREEN,
+    Color_MAGENTA = Color_RED   | Color_BLUE,
+    Color_CYAN    = Color_GREEN | Color_BLUE,
 };
 
 V4 colors[8] = {
     v4(1, 1, 1, 1),
     v4(1, 0, 0, 1),
     v4(0, 1, 0, 1),
-    v4(0, 0, 1, 1),
     v4(1, 1, 0, 1), // Yellow
+    v4(0, 0, 1, 1),
     v4(1, 0, 1, 1), // Magenta
     v4(0, 1, 1, 1), // Cyan
+    v4(1, 1, 1, 1),
 };
 
+// @Note: color_mix_table[cur][src] is what a square lit by `cur` becomes when `src` hits it.
+// Primaries add up, two different secondaries keep what they share, a secondary absorbs its own
+// primaries and cancels with the other one. It's not associative, so beams still mix in trace
+// order. All three bits set never happens; it mixes to WHITE.
+//
+#define W Color_WHITE
+#define R Color_RED
+#define G Color_GREEN
+#define B Color_BLUE
+#define Y Color_YELLOW
+#define M Color_MAGENTA
+#define C Color_CYAN
+constexpr u8 color_mix_table[8][8] = {
+    {W, R, G, Y, B, M, C, W},
+    {R, R, Y, Y, M, M, W, W},
+    {G, Y, G, Y, C, W, C, W},
+    {Y, Y, Y, Y, W, R, G, W},
+    {B, M, C, W, B, M, C, W},
+    {M, M, W, R, M, M, B, W},
+    {C, W, C, G, C, B, C, W},
+    {W, W, W, W, W, W, W, W},
+};
+#undef W
+#undef R
+#undef G
+#undef B
+#undef Y
+#undef M
+#undef C
+
 enum
 {
     ObjFlags_NONE = 0,
@@ -284,12 +321,235 @@ struct Obj
     u8 c; // The actual color of the object. Used for emitters, detectors and doors.
 };
 
+struct Obj_Map
+{
+    // @Note: The level is stored as one contiguous block, a plane per Obj field, so passes that
+    // only care about one field (e.g. type) walk a single tight array. Square [x,y] is
+    // index y*pitch + x in every plane, and color has 8 entries per square.
+    //
+    s32 pitch; // Number of columns.
+    s32 rows;
+    u8 *type;
+    u8 *dir;
+    u8 *flags;
+    u8 *c;
+    u8 *color;
+};
+
 struct Player
 {
     s32 x, y;
     u8 dir;
 };
 
+////////////////////////////////
+////////////////////////////////
+// Beams
+//
+enum Beam_Work_Type
+{
+    BeamWork_TRACE, // March from [x,y] in dir until we hit something, then reflect/penetrate.
+    BeamWork_EMIT,  // Deferred reflected beam of a splitter; runs once its penetrating beam is done.
+};
+
+struct Beam_Work
+{
+    s16 x, y;
+    u8  type;
+    u8  dir;
+    u8  color;
+    u8  old_color; // BeamWork_EMIT: splitter's color[dir] at the moment the beam hit it.
+};
+
+// @Note: What a beam does when it hits an optical obj, indexed by
+// [obj type][obj dir][dir the beam travels in]. `reflected` is U8_MAX if nothing gets reflected;
+// a penetrating beam keeps going in its dir. Only splitters penetrate.
+//
+struct Beam_Optics
+{
+    u8 reflected;
+    u8 penetrate;
+};
+
+struct Beam_Optics_Table
+{
+    Beam_Optics e[T_COUNT][8][8];
+};
+
+constexpr Beam_Optics_Table make_beam_optics_table()
+{
+    Beam_Optics_Table t = {};
+    for (s32 type = 0; type < T_COUNT; type++) {
+        for (s32 obj_d = 0; obj_d < 8; obj_d++) {
+            for (s32 src_d = 0; src_d < 8; src_d++) {
+                t.e[type][obj_d][src_d].reflected = U8_MAX;
+                t.e[type][obj_d][src_d].penetrate = FALSE;
+            }
+        }
+    }
+    
+    for (s32 obj_d = 0; obj_d < 8; obj_d++) {
+        for (s32 src_d = 0; src_d < 8; src_d++) {
+            s32 inv_d   = WRAP_D(src_d + 4);
+            s32 ninv_d  = WRAP_D(inv_d + 1);
+            s32 pinv_d  = WRAP_D(inv_d - 1);
+            s32 p2inv_d = WRAP_D(inv_d - 2);
+            
+            Beam_Optics &mirror = t.e[T_MIRROR][obj_d][src_d];
+            if      (obj_d == inv_d)  mirror.reflected = (u8)inv_d;
+            else if (obj_d == ninv_d) mirror.reflected = (u8)WRAP_D(ninv_d + 1);
+            else if (obj_d == pinv_d) mirror.reflected = (u8)WRAP_D(pinv_d - 1);
+            
+            Beam_Optics &bender = t.e[T_BENDER][obj_d][src_d];
+            if      (obj_d == inv_d)   bender.reflected = (u8)ninv_d;
+            else if (obj_d == ninv_d)  bender.reflected = (u8)WRAP_D(ninv_d + 2);
+            else if (obj_d == pinv_d)  bender.reflected = (u8)pinv_d;
+            else if (obj_d == p2inv_d) bender.reflected = (u8)WRAP_D(p2inv_d - 1);
+            
+            Beam_Optics &splitter = t.e[T_SPLITTER][obj_d][src_d];
+            splitter.penetrate    = TRUE;
+            if (obj_d == inv_d || obj_d == src_d)
+                splitter.penetrate = TRUE;
+            else if (obj_d == ninv_d || obj_d == WRAP_D(src_d + 1))
+                splitter.reflected = (u8)WRAP_D(ninv_d + 1);
+            else if (obj_d == pinv_d || obj_d == WRAP_D(src_d - 1))
+                splitter.reflected = (u8)WRAP_D(pinv_d - 1);
+            else
+                splitter.penetrate = FALSE;
+        }
+    }
+    return t;
+}
+constexpr Beam_Optics_Table beam_optics = make_beam_optics_table();
+
+// @Note: A straight piece of beam leaving [x,y] in `dir`. It lights `lit_length` squares: the
+// empty ones it passes over, plus the obj it hits (if any). Segments are ordered by (laser, seq),
+// which is the order a full retrace would produce them in.
+//
+struct Beam_Segment
+{
+    s16 x, y;
+    u8  dir;
+    u8  color;
+    u16 lit_length;
+    s32 laser;
+    s32 seq;
+    s32 next; // Next segment leaving the same square, or next free segment.
+};
+
+// @Note: Beam laser. Lasers that hit a common obj form a group (union-find over `parent`), and a
+// group is always retraced as a whole, in the same order as a full rebuild, so colors mix the
+// same way no matter how much of the map we retraced.
+//
+struct Beam_Laser
+{
+    s16 x, y;
+    s32 parent;
+    s32 first_square; // Head of the list of squares this laser claimed (linked by Beam_Tracer.next).
+    b32 dirty;        // Only meaningful on the group root.
+    b32 retracing;
+};
+
+// @Note: We trace beams using an explicit stack instead of recursion. Each (square, dir, color) is
+// traced at most once per retrace, so the stack can never hold more than 2 items per visited bit
+// (one TRACE and one EMIT), and there's at most one segment per visited bit. Everything is
+// allocated from current_level_arena.
+//
+// Beams are only retraced when something they pass through or hit changes (see
+// beams_mark_dirty()); on a quiet tick update_world() doesn't trace anything.
+//
+// Segments don't march square by square; `jump` holds, for every square and dir, the distance to
+// the next square that stops beams (wall or obj), or to the first square outside the map.
+//
+#define NUM_BEAM_COLORS 8
+struct Beam_Tracer
+{
+    Beam_Work *stack;
+    s32        stack_count;
+    s32        stack_capacity;
+    
+    // Lasers in trace order (red first).
+    Beam_Laser *lasers;
+    s32         lasers_count;
+    s32         lasers_capacity;
+    
+    Beam_Segment *segments;
+    s32           segments_capacity;
+    s32           first_free_segment;
+    s32           seq;
+    
+    // Per square.
+    s32  width;
+    s32  num_squares;
+    u64 *visited;       // One bit per (dir, color).
+    s32 *owner;         // Laser that claimed the square (emitted from it or hit it), or -1.
+    s32 *next;          // Next square claimed by the same laser, or -1.
+    s32 *first_segment; // Segments leaving the square, or -1.
+    u8  *blocks;        // Whether the square stops beams, as of the last jump table update.
+    u16 *jump;          // 8 per square.
+    
+    b32 rebuild;  // Recollect lasers, rebuild the jump table and retrace everything.
+};
+
+////////////////////////////////
+////////////////////////////////
+// Obj index
+//
+// @Note: Squares of all non-empty objs, one list per type, so per-frame passes don't have to scan
+// the whole map. Open and closed doors share the T_DOOR list. Lists are in map order after a
+// rebuild; moving an obj keeps its place in the list.
+//
+struct Obj_Index
+{
+    s32 *squares[T_COUNT];
+    s32  counts[T_COUNT];
+    s32 *slot;  // Per square: position in its type's list, or -1.
+    s32  width;
+    
+    b32 rebuild;
+};
+
+////////////////////////////////
+////////////////////////////////
+// Doors
+//
+// @Note: Doors and detectors of the same color in the same room. Doors and detectors never move,
+// so the index is only rebuilt when the level is loaded or edited.
+//
+struct Door_Group
+{
+    u8  c;
+    s32 first_detector;
+    s32 detectors_count;
+    s32 first_door;
+    s32 doors_count;
+};
+
+struct Door_Index
+{
+    V2s *detectors; // Grouped, in map order within a group.
+    V2s *doors;     // Grouped, in map order within a group.
+    s32  detectors_count;
+    s32  doors_count;
+    
+    Door_Group *groups;
+    s32         groups_count;
+    s32         groups_capacity;
+    
+    b32 rebuild;
+};
+
+// @Note: Upper bound of what a live level pushes on current_level_arena per square (objmap,
+// tilemap, obj index, beam tracer and door index). Rooms are at least one square. The beam
+// tracer's stack and segments are most of it.
+//
+#define LEVEL_BYTES_PER_SQUARE (12 + 1 +                                                       \
+                                (T_COUNT + 1)*sizeof(s32) +                                    \
+                                2*8*NUM_BEAM_COLORS*sizeof(Beam_Work) +                        \
+                                8*NUM_BEAM_COLORS*sizeof(Beam_Segment) + sizeof(Beam_Laser) + \
+                                sizeof(u64) + 3*sizeof(s32) + sizeof(u8) + 8*sizeof(u16) +     \
+                                2*sizeof(V2s) + 8*sizeof(Door_Group))
+
 ////////////////////////////////
 ////////////////////////////////
 // Global current state
@@ -302,8 +562,30 @@ GLOBAL s32 NUM_X;
 GLOBAL s32 NUM_Y;
 GLOBAL s32 SIZE_X;
 GLOBAL s32 SIZE_Y;
-GLOBAL u8  **tilemap;
-GLOBAL Obj **objmap;
+GLOBAL u8     *tilemap;
+GLOBAL Obj_Map objmap;
+#define MAP_IDX(x, y) ((y)*objmap.pitch + (x))
+GLOBAL Beam_Tracer beam_tracer;
+GLOBAL Door_Index door_index;
+GLOBAL Obj_Index obj_index;
+
+// @Note: A spare set of the buffers above. prefetch_level() builds the next level in it while the
+// teleport transition plays, and loading that level swaps it with the live set.
+//
+struct Level_Buffers
+{
+    Arena *arena;
+    s32 num_x, num_y;
+    s32 size_x, size_y;
+    u8 *tilemap;
+    Obj_Map objmap;
+    Beam_Tracer beam_tracer;
+    Door_Index door_index;
+    Obj_Index obj_index;
+    
+    b32 ready; // Holds level_idx, untouched since prefetch_level().
+    s32 level_idx;
+};
 
 // Square position of mouse cursor.
 GLOBAL s32 mx; GLOBAL s32 my;
@@ -357,56 +639,32 @@ GLOBAL f32 zoom_level;
 // Levels
 //
 
-// @Todo:
-// @Todo:
-// @Todo: Make editing these easy, I don't want to worry about id and name mismatch....
-//
 GLOBAL s32 const LEVELS_PER_ROW = 6; // For level select.
-GLOBAL String8 level_names[] = 
+
+// @Note: The level set lives in data/levels.txt (see the comment at its top), which we read once
+// at startup. Level ids index levels[]; ids is the reverse lookup from names.
+//
+enum Level_Flags
 {
-    S8LIT("invalid_level"),
-    S8LIT("aaa_placeholder1"),
-    S8LIT("aaa_placeholder2"),
-    S8LIT("aaa_placeholder3"),
-    
-    S8LIT("intro"),
-    
-    S8LIT("mirror_intro"),
-    S8LIT("red_intro"),
-    S8LIT("splitter_intro"),
-    S8LIT("teach_rotation"),
-    S8LIT("block_the_source"),
-    S8LIT("sokobaning"),
-    S8LIT("mirror_first_challenge"),
-    
-    S8LIT("primary_mixing_intro"),
-    S8LIT("splitter_first_challenge"),
-    S8LIT("make_way"),
-    
-    S8LIT("bender_intro"),
-    S8LIT("mirror_bender_relationship1"),
-    S8LIT("bender_splitter_relationship"),
-    
-    S8LIT("connected_rooms"),
-    
-    S8LIT("splitter_locked1"),
-    
-    S8LIT("crossing_red_intro1"),
-    S8LIT("crossing_magenta"),
-    S8LIT("crossing_red_medium"),
-    
-    S8LIT("tie_cyan"),
-    
-    S8LIT("stack"),
-    S8LIT("stack_hard"),
-    
-    S8LIT("colored_splitter_intro"),
-    S8LIT("colored_splitter_primary_mixing"),
-    S8LIT("colored_splitter_crossing_red"),
+    LevelFlags_INFO_CONTROLS = 1 << 0,
+    LevelFlags_INFO_MIXING   = 1 << 1,
+};
+
+struct Level_Info
+{
+    String8 name; // Empty if no level has this id.
+    u32     flags;
+};
+
+struct Level_Manifest
+{
+    Level_Info *levels;
+    s32 levels_count;
+    Table<String8, s32> ids;
     
-    S8LIT("chain_big"),
-    S8LIT("loop_medium"),
+    u32 hash; // Of the file, so the level package knows when it's out of date.
 };
+GLOBAL Level_Manifest manifest;
 
 enum 
 {
@@ -414,6 +672,7 @@ enum
     SaveFileVersion_ADD_MASTER_VOLUME,
     SaveFileVersion_REMOVE_NAME_ADD_ID,
     SaveFileVersion_ADD_LATEST_LEVEL_ID,
+    SaveFileVersion_ADD_LEVEL_STATE,
     
     SaveFileVersion_COUNT,
 };
@@ -427,26 +686,178 @@ struct Settings
     s32 master_volume; // Integer value in range [0, 10]
 };
 
+// @Note: Progress in the current level, written after Settings: the player, then cells_count
+// Save_Cells for the squares that differ from the pristine level, then the undo log (undo_save()).
+//
+struct Save_Level_State
+{
+    u32 manifest_hash; // The state is dropped if the levels changed since.
+    s32 pitch, rows;
+    s32 px, py;
+    s32 pdir;
+    s32 cells_count;
+};
+
+struct Save_Cell
+{
+    u32 idx;
+    u8  type, dir, flags, c;
+};
+
 enum
 {
     LevelVersion_INIT,
     LevelVersion_REMOVE_ID,
     LevelVersion_ADD_NAME,
     LevelVersion_REMOVE_NAME_ADD_ID,
+    LevelVersion_RGB_COLORS,
+    LevelVersion_BULK,
+    LevelVersion_RLE,
     
     LevelVersion_COUNT,
 };
 
+enum
+{
+    PlaneEncoding_RAW,
+    PlaneEncoding_RLE,
+};
+
+// @Note: A live level takes up to LEVEL_BYTES_PER_SQUARE per square, so levels are at most as
+// many squares as fit in LEVEL_MEMORY_BUDGET, and never more than the solver indexes with a u16.
+//
+#define LEVEL_MEMORY_BUDGET MEGABYTES(128)
+#define LEVEL_MAX_SQUARES   ((s32)MIN(U16_MAX, LEVEL_MEMORY_BUDGET/LEVEL_BYTES_PER_SQUARE))
+
 struct Loaded_Level
 {
-    s32 idx;            // level_names[idx] is name of level.
+    s32 idx;            // manifest.levels[idx] is the level.
     s32 num_x, num_y;   // Number of rooms.
     s32 size_x, size_y; // Size of each room (in squares).
     Player player;
-    Obj **obj_map;
-    u8  **tile_map;
+    Obj_Map obj_map;
+    u8     *tile_map;
 };
 
+////////////////////////////////
+////////////////////////////////
+// Level package.
+//
+// @Note: levels.pkg holds every level, already migrated to the latest LevelVersion, so we read a
+// single file at startup and Loaded_Level points straight into it. Layout:
+//
+//     Level_Package_Header
+//     Level_Package_Entry[levels_count] (indexed by level id; offset is 0 if missing)
+//     Per level: the 12 obj planes (as in Obj_Map) followed by the tile plane.
+//
+#define LEVEL_PACKAGE_MAGIC   0x4B50524E // "NRPK"
+#define LEVEL_PACKAGE_VERSION 3
+
+struct Level_Package_Header
+{
+    u32 magic;
+    s32 package_version;
+    s32 level_version;
+    s32 levels_count;
+    u32 manifest_hash;
+    u32 size; // Of the whole file.
+};
+
+struct Level_Package_Entry
+{
+    s32 idx;
+    s32 num_x, num_y;
+    s32 size_x, size_y;
+    Player player;
+    u32 offset;      // Of the level's planes, from the start of the file.
+    u32 source_hash; // Of the .nlf it was built from (even if that didn't parse).
+};
+
+struct Level_Package
+{
+    String8 data;
+    Level_Package_Entry *entries;
+    s32 levels_count;
+    
+    b32 dirty; // A level was saved; rebuild before loading anything.
+};
+
+////////////////////////////////
+////////////////////////////////
+// Input replays.
+//
+// @Note: A recording starts from a freshly loaded level and stores, for every tick, the input the
+// game saw plus a hash of the state after the tick. Playing it back restores the same starting point,
+// feeds the input through game_update() and checks the hash, so a replay doubles as a benchmark and
+// as a bit-exact regression test. Layout:
+//
+//     Replay_Header
+//     Replay_Tick[ticks_count]
+//
+// Mouse input isn't recorded; only the editor uses it.
+//
+#define REPLAY_MAGIC   0x4345524E // "NREC"
+#define REPLAY_VERSION 1
+
+#define REPLAY_KEY_BYTES ((Key_COUNT + 7) / 8)
+
+enum Replay_Mode
+{
+    ReplayMode_NONE,
+    
+    ReplayMode_RECORDING,
+    ReplayMode_PLAYING,
+};
+
+struct Replay_Header
+{
+    u32 magic;
+    s32 version;
+    u32 manifest_hash;
+    s32 ticks_count;
+    
+    // Starting point.
+    s32 level_idx;
+    s32 latest_level_idx;
+    b32 prompt_user_on_restart;
+    f32 dt;
+    f64 time;
+    Random_PCG rng;
+};
+
+struct Replay_Tick
+{
+    u8  pressed [REPLAY_KEY_BYTES];
+    u8  held    [REPLAY_KEY_BYTES];
+    u8  released[REPLAY_KEY_BYTES];
+    
+    // Gamepad 0 only, one bit per button.
+    b32 gamepad_connected;
+    u32 gamepad_pressed;
+    u32 gamepad_held;
+    u32 gamepad_released;
+    
+    s32 level_idx;  // At the start of the tick.
+    u64 state_hash; // After the tick.
+};
+
+struct Replay
+{
+    Replay_Mode mode;
+    Replay_Header header;
+    Array<Replay_Tick> ticks;
+    s32 cursor;
+    
+    s32 mismatch_tick; // First tick whose hash didn't match, -1 if none.
+    
+    // Real input, put back after each played tick so the platform layer's key state isn't clobbered.
+    b32 saved_pressed [Key_COUNT];
+    b32 saved_held    [Key_COUNT];
+    b32 saved_released[Key_COUNT];
+    Gamepad saved_gamepad;
+};
+GLOBAL Replay replay;
+
 ////////////////////////////////
 ////////////////////////////////
 // Sound manager.
@@ -490,6 +901,13 @@ struct Game_State
     Arena *loaded_level_arena;
     Loaded_Level loaded_level;
     
+    Arena *package_arena;
+    Level_Package package;
+    
+    Level_Buffers prefetched;
+    
+    Arena *save_arena; // See begin_save_buffer().
+    
     Sound_Manager sound_manager;
     
     Particle_Emitter obj_emitter;
@@ -0,0 +1,347 @@
+// @Note: Headless Linux platform layer. No window, no GPU, no audio device: it drives game_update()
+// at the fixed dt as fast as it can, runs game_render() against the null renderer and mixes sound
+// into a buffer nobody listens to. Meant for profiling and regression-testing the simulation.
+//
+// Usage: nur_headless [ticks] [level_name]
+//        nur_headless -replay <file>
+//        nur_headless -record <file> <level_name> [ticks] [seed]
+//        nur_headless -bench [ticks]
+//        nur_headless -undo-check [ticks]
+// Without a level name the run stays wherever game_init() leaves us (the main menu). With -replay it
+// plays the recording back (see replay.h), checks every tick's state hash and exits with 1 if the
+// simulation diverged. With -record it plays the level under scripted input seeded with `seed` and
+// saves that as a recording. With -bench it times update_world() on every level and prints JSON to
+// stdout. With -undo-check it checks undo_jump() against walking the history on every level (exit
+// code 1 if not).
+//
+#define HEADLESS 1
+
+#include <string.h>
+
+#define ORH_STATIC
+#define ORH_IMPLEMENTATION
+#include "orh.h"
+#include "posix_file.h"
+#include "linux_os.h"
+#include "orh_null.cpp"
+
+#include "game.h"
+#include "game.cpp"
+
+// For loading ogg vorbis audio files.
+#include "stb/stb_vorbis.c"
+
+FUNCTION Sound linux_sound_load(String8 full_path, u32 sample_rate)
+{
+    String8 file = posix_map_file(full_path);
+    if (!file.data) {
+        print("Couldn't load sound file %S\n", full_path);
+        
+        Sound dummy = {};
+        return dummy;
+    }
+    
+    s16 *out;
+    s32 chan, samplerate;
+    s32 count = stb_vorbis_decode_memory(file.data, (s32)file.count, &chan, &samplerate, &out);
+    posix_unmap_file(file);
+    
+    if (count == -1) {
+        print("STB Error: Couldn't load sound file %S\n", full_path);
+        
+        Sound dummy = {};
+        return dummy;
+    }
+    
+    // @Note: Make sure we are loading mono audio with specified sample rate.
+    ASSERT((chan == 1) && ((u32)samplerate == sample_rate));
+    
+    Sound result;
+    result.samples = out;
+    result.count   = result.pos = (u32)count;
+    
+    return result;
+}
+
+////////////////////////////////
+// Benchmark.
+//
+FUNCTION int linux_compare_u64(const void *a, const void *b)
+{
+    u64 x = *(u64 *)a;
+    u64 y = *(u64 *)b;
+    return (x > y) - (x < y);
+}
+
+FUNCTION void linux_press_scripted_key(Random_PCG *rng)
+{
+    // @Note: Scripted input for the modes below: now and then a walk (which also pushes), a rotation
+    // or an undo, picked by a fixed-seed PRNG so runs are comparable across commits. Only presses
+    // this tick; the caller clears the key states after it.
+    //
+    Game_Input_Binds *b = binds;
+    Key script[] = {
+        b[MOVE_RIGHT].keyboard[0], b[MOVE_UP].keyboard[0], b[MOVE_LEFT].keyboard[0], b[MOVE_DOWN].keyboard[0],
+        b[ROTATE_CCW].keyboard[0], b[ROTATE_CW].keyboard[0],
+        b[UNDO].keyboard[0],
+    };
+    
+    if (random_range(rng, 0, 8) == 0) {
+        u32 roll = random_range(rng, 0, 100);
+        s32 key  = (roll < 60)? script[roll % 4] : (roll < 85)? script[4 + (roll % 2)] : script[6];
+        os->pressed[key] = TRUE;
+        os->held[key]    = TRUE;
+    }
+}
+
+FUNCTION void linux_run_benchmark(s64 ticks)
+{
+    // @Note: Every level runs update_world() for the same number of ticks under the same scripted
+    // input. Reports are JSON on stdout, one object per level.
+    //
+    u64 *samples = PUSH_ARRAY(os->permanent_arena, u64, ticks);
+    
+    printf("{\n  \"ticks\": %lld,\n  \"dt\": %f,\n  \"levels\": [", (long long)ticks, os->dt);
+    b32 first = TRUE;
+    for (s32 idx = 0; idx < manifest.levels_count; idx++) {
+        // Reserved ids have no level in the package.
+        if (!game->package.entries[idx].offset || !load_level(idx))
+            continue;
+        
+        game_started           = TRUE;
+        current_mode           = M_GAME;
+        prompt_user_on_restart = FALSE;
+        game->rng              = random_seed();
+        Random_PCG script_rng  = random_seed(idx);
+        s32 squares            = NUM_X*SIZE_X*NUM_Y*SIZE_Y;
+        
+        for (s64 t = 0; t < ticks; t++) {
+            // Finishing the level teleports us to the next one; stay on this one.
+            if (current_level_idx != idx) {
+                load_level(idx);
+                current_mode = M_GAME;
+            }
+            
+            linux_press_scripted_key(&script_rng);
+            
+            u64 start = linux_get_nanoseconds();
+            update_world();
+            samples[t] = linux_get_nanoseconds() - start;
+            
+            clear_key_states();
+            MEMORY_ZERO_ARRAY(os->held);
+            os->time += os->dt;
+        }
+        
+        u64 total = 0;
+        for (s64 t = 0; t < ticks; t++)
+            total += samples[t];
+        qsort(samples, (size_t)ticks, sizeof(u64), linux_compare_u64);
+        
+        printf("%s\n    {\"name\": \"%.*s\", \"squares\": %d, \"min_ns\": %llu, \"median_ns\": %llu, \"p99_ns\": %llu, \"mean_ns\": %llu, \"level_arena_bytes\": %llu, \"undo_bytes\": %llu}",
+               first? "" : ",",
+               (int)manifest.levels[idx].name.count, (char *)manifest.levels[idx].name.data,
+               squares,
+               (unsigned long long)samples[0],
+               (unsigned long long)samples[ticks/2],
+               (unsigned long long)samples[MIN(ticks-1, ticks*99/100)],
+               (unsigned long long)(total/ticks),
+               (unsigned long long)current_level_arena->used,
+               (unsigned long long)undo_memory_used(&undo_handler));
+        first = FALSE;
+    }
+    printf("\n  ]\n}\n");
+}
+
+////////////////////////////////
+// Undo check.
+//
+FUNCTION u64 linux_settled_state_hash()
+{
+    // @Note: Doors follow the beams, so update the map until it stops changing; two ways of getting
+    // to the same step may pass through different door states on the way. The player's facing isn't
+    // part of it: walking into a wall turns the player without making a record.
+    //
+    s32 n = objmap.pitch*objmap.rows;
+    u64 result = 0;
+    for (s32 i = 0; i < 8; i++) {
+        obj_index_update(&obj_index);
+        beams_update(&beam_tracer);
+        door_index_update(&door_index);
+        
+        u64 hash = ((u64)get_hash(string(objmap.type, 12*n)) << 32) | ((u32)px << 16) | (u32)py;
+        if (hash == result)
+            break;
+        result = hash;
+    }
+    return result;
+}
+
+FUNCTION b32 linux_run_undo_check(s64 ticks)
+{
+    // @Note: Plays every level for `ticks` ticks of scripted input, then walks the history it left
+    // all the way back and forth with undo/redo, and jumps around it with undo_jump(). Every jump must
+    // land on the state the walk saw at that step, whether it walked there or restored a checkpoint.
+    //
+    b32 result = TRUE;
+    for (s32 idx = 0; idx < manifest.levels_count; idx++) {
+        if (!game->package.entries[idx].offset || !load_level(idx))
+            continue;
+        
+        game_started           = TRUE;
+        current_mode           = M_GAME;
+        prompt_user_on_restart = FALSE;
+        game->rng              = random_seed();
+        Random_PCG script_rng  = random_seed(idx);
+        
+        for (s64 t = 0; t < ticks; t++) {
+            if (current_level_idx != idx) {
+                load_level(idx);
+                current_mode = M_GAME;
+            }
+            
+            linux_press_scripted_key(&script_rng);
+            update_world();
+            
+            clear_key_states();
+            MEMORY_ZERO_ARRAY(os->held);
+            os->time += os->dt;
+        }
+        
+        Arena_Temp scratch = get_scratch(0, 0);
+        s32 depth  = undo_depth(&undo_handler);
+        u64 *walk  = PUSH_ARRAY(scratch.arena, u64, depth+1);
+        s32 failed = -1;
+        
+        walk[depth] = linux_settled_state_hash();
+        for (s32 step = depth-1; step >= 0; step--) {
+            undo_next(&undo_handler);
+            walk[step] = linux_settled_state_hash();
+        }
+        for (s32 step = 1; step <= depth && failed < 0; step++) {
+            undo_redo(&undo_handler);
+            if (linux_settled_state_hash() != walk[step])
+                failed = step;
+        }
+        
+        s32 jumps = 0;
+        for (s32 i = 0; i < 256 && failed < 0; i++) {
+            // The two ends first: both are a checkpoint restore away from where we are.
+            s32 target = (i == 0)? 0 : (i == 1)? depth : (s32)random_range(&script_rng, 0, (u32)depth+1);
+            undo_jump(&undo_handler, target);
+            jumps++;
+            
+            if (undo_depth(&undo_handler) != target || linux_settled_state_hash() != walk[target])
+                failed = target;
+        }
+        free_scratch(scratch);
+        
+        print("Undo check: %S, %d steps, %d jumps: %s\n", manifest.levels[idx].name, depth, jumps,
+              failed < 0? "OK" : "MISMATCH");
+        if (failed >= 0) {
+            print("Undo check: state at step %d differs from the walk\n", failed);
+            result = FALSE;
+        }
+    }
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    s64 ticks_to_run  = 120*60;
+    char *start_level = 0;
+    char *replay_path = 0;
+    char *record_path = 0;
+    u64 record_seed   = 0;
+    b32 bench         = FALSE;
+    b32 undo_check    = FALSE;
+    if ((argc > 2) && (strcmp(argv[1], "-replay") == 0)) {
+        replay_path = argv[2];
+    } else if ((argc > 3) && (strcmp(argv[1], "-record") == 0)) {
+        record_path  = argv[2];
+        start_level  = argv[3];
+        ticks_to_run = (argc > 4)? atoll(argv[4]) : 3600;
+        record_seed  = (argc > 5)? (u64)atoll(argv[5]) : 1;
+    } else if ((argc > 1) && (strcmp(argv[1], "-bench") == 0)) {
+        bench        = TRUE;
+        ticks_to_run = (argc > 2)? atoll(argv[2]) : 10000;
+    } else if ((argc > 1) && (strcmp(argv[1], "-undo-check") == 0)) {
+        undo_check   = TRUE;
+        ticks_to_run = (argc > 2)? atoll(argv[2]) : 20000;
+    } else {
+        if (argc > 1)
+            ticks_to_run = atoll(argv[1]);
+        if (argc > 2)
+            start_level = argv[2];
+    }
+    
+    linux_os_init(linux_sound_load);
+    
+    game_init();
+    
+    if (start_level) {
+        if (!load_level(string(start_level)))
+            return 1;
+        game_started = TRUE;
+        current_mode = M_GAME;
+    }
+    if (bench) {
+        if (ticks_to_run > 0)
+            linux_run_benchmark(ticks_to_run);
+        return 0;
+    }
+    if (undo_check)
+        return linux_run_undo_check(ticks_to_run)? 0 : 1;
+    if (replay_path) {
+        if (!replay_load(string(replay_path)))
+            return 1;
+        replay_begin_playback();
+        ticks_to_run = replay.ticks.count;
+    }
+    Random_PCG script_rng = random_seed(record_seed);
+    if (record_path)
+        replay_begin_recording();
+    
+    // @Note: Null audio sink. One tick's worth of samples per tick, and all of it counts as played.
+    u32 samples_per_tick = (u32)(global_os.sample_rate * global_os.dt);
+    f32 *samples         = PUSH_ARRAY(global_os.permanent_arena, f32, samples_per_tick*2);
+    
+    //
+    // Game loop.
+    
+    f64 start = linux_get_seconds();
+    s64 ticks = 0;
+    while (!global_os.exit && (ticks < ticks_to_run)) {
+        if (record_path)
+            linux_press_scripted_key(&script_rng);
+        
+        game_update();
+        
+        global_os.samples_out        = samples;
+        global_os.samples_to_advance = global_os.samples_to_write;
+        global_os.samples_to_write   = samples_per_tick;
+        MEMORY_ZERO(global_os.samples_out, global_os.samples_to_write * global_os.bytes_per_sample);
+        game_fill_sound_buffer();
+        
+        game_render();
+        
+        os->time += os->dt;
+        clear_key_states();
+        if (record_path)
+            MEMORY_ZERO_ARRAY(global_os.held);
+        ticks++;
+    }
+    f64 seconds = linux_get_seconds() - start;
+    
+    printf("%lld ticks in %.3f s (%.1f ticks/s)\n", (long long)ticks, seconds, seconds > 0? ticks/seconds : 0.0);
+    
+    if (record_path)
+        replay_end_recording(string(record_path));
+    
+    // Don't exit before the saves are on disk.
+    posix_wait_for_file_writes();
+    
+    if (replay_path && replay.mismatch_tick >= 0)
+        return 1;
+    return 0;
+}
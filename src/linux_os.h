@@ -0,0 +1,145 @@
+#ifndef LINUX_OS_H
+#define LINUX_OS_H
+
+// @Note: The parts of a Linux platform layer every headless tool shares: memory, timing, console and
+// paths, plus filling in OS_State. Include after orh.h and posix_file.h.
+//
+
+#include <sys/mman.h>
+#include <time.h>
+
+GLOBAL OS_State global_os;
+GLOBAL char     global_exe_full_path[256];
+GLOBAL char     global_exe_parent_folder[256];
+GLOBAL char     global_data_folder[256];
+
+#define LINUX_PAGE_SIZE 4096
+
+FUNCTION f64 linux_get_seconds()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    f64 result = (f64)t.tv_sec + (f64)t.tv_nsec / 1000000000.0;
+    return result;
+}
+
+FUNCTION u64 linux_get_nanoseconds()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    u64 result = (u64)t.tv_sec*1000000000ULL + (u64)t.tv_nsec;
+    return result;
+}
+
+FUNCTION void* linux_reserve(u64 size)
+{
+    // @Note: munmap() needs the size, but release() only gets the pointer. So we reserve one extra
+    // page in front and keep the size there.
+    //
+    u64 total = size + LINUX_PAGE_SIZE;
+    u8 *base  = (u8 *) mmap(0, total, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED)
+        return 0;
+    
+    mprotect(base, LINUX_PAGE_SIZE, PROT_READ|PROT_WRITE);
+    *(u64 *)base = total;
+    
+    void *memory = base + LINUX_PAGE_SIZE;
+    return memory;
+}
+FUNCTION void  linux_release(void *memory)
+{
+    if (memory) {
+        u8 *base = (u8 *)memory - LINUX_PAGE_SIZE;
+        munmap(base, *(u64 *)base);
+    }
+}
+FUNCTION b32  linux_commit(void *memory, u64 size)
+{
+    b32 result = (mprotect(memory, size, PROT_READ|PROT_WRITE) == 0);
+    return result;
+}
+FUNCTION void  linux_decommit(void *memory, u64 size)
+{
+    madvise(memory, size, MADV_DONTNEED);
+    mprotect(memory, size, PROT_NONE);
+}
+FUNCTION void linux_print_to_console(String8 text)
+{
+    // @Note: stderr, so stdout stays free for whatever the run is reporting.
+    fwrite(text.data, 1, text.count, stderr);
+}
+
+FUNCTION void linux_build_paths()
+{
+    ssize_t length = readlink("/proc/self/exe", global_exe_full_path, sizeof(global_exe_full_path) - 1);
+    if (length < 0) length = 0;
+    global_exe_full_path[length] = 0;
+    
+    char *one_past_slash = global_exe_full_path;
+    char *exe            = global_exe_full_path;
+    while (*exe)  {
+        if (*exe++ == '/') one_past_slash = exe;
+    }
+    MEMORY_COPY(global_exe_parent_folder, global_exe_full_path, one_past_slash - global_exe_full_path);
+
+#if DEVELOPER
+    string_format(global_data_folder, sizeof(global_data_folder), "%s../data/", global_exe_parent_folder);
+#else
+    // @Note: We will copy the data folder when building the game and put it next to the executable.
+    string_format(global_data_folder, sizeof(global_data_folder), "%sdata/", global_exe_parent_folder);
+#endif
+}
+
+FUNCTION void linux_os_init(Sound (*sound_load)(String8 full_path, u32 sample_rate))
+{
+    linux_build_paths();
+    os = &global_os;
+    
+    // Meta-data.
+    global_os.exe_full_path     = string(global_exe_full_path);
+    global_os.exe_parent_folder = string(global_exe_parent_folder);
+    global_os.data_folder       = string(global_data_folder);
+    
+    // Options.
+    global_os.fullscreen        = FALSE;
+    global_os.exit              = FALSE;
+    global_os.vsync             = FALSE;
+    global_os.fix_aspect_ratio  = TRUE;
+    global_os.render_size       = {1920, 1080};
+    global_os.window_size       = global_os.render_size;
+    global_os.drawing_rect      = aspect_ratio_fit(global_os.render_size, global_os.window_size);
+    global_os.dt                = 1.0f/120.0f;
+    global_os.fps_max           = 0;
+    global_os.time              = 0.0f;
+    
+    // Functions.
+    global_os.reserve           = linux_reserve;
+    global_os.release           = linux_release;
+    global_os.commit            = linux_commit;
+    global_os.decommit          = linux_decommit;
+    global_os.print_to_console  = linux_print_to_console;
+    global_os.read_entire_file  = posix_read_entire_file;
+    global_os.write_entire_file = posix_write_entire_file;
+    global_os.write_entire_file_async = posix_write_entire_file_async;
+    global_os.wait_for_file_writes    = posix_wait_for_file_writes;
+    global_os.free_file_memory  = posix_free_file_memory;
+    global_os.map_file          = posix_map_file;
+    global_os.unmap_file        = posix_unmap_file;
+    global_os.sound_load        = sound_load;
+    
+    // Arenas.
+    global_os.permanent_arena  = arena_init();
+    
+    // User Input.
+    array_init_static(&global_os.inputs_to_process, 512);
+    
+    // Audio Output.
+    global_os.sample_rate        = 48000;
+    global_os.bytes_per_sample   = 2*sizeof(f32);
+    global_os.samples_out        = 0;
+    global_os.samples_to_write   = 0;
+    global_os.samples_to_advance = 0;
+}
+
+#endif //LINUX_OS_H
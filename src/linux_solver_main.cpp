@@ -0,0 +1,1749 @@
+// @Note: Headless level solver and verifier. A* search over the levels in the package, using the
+// game's own rules: move_player()/move_obj(), rotate_objs_around_player(), beams_update() and
+// door_index_update(). Prints each level's shortest solution as JSON on stdout, followed by the
+// levels it couldn't solve and why, and exits with 1 if there are any.
+//
+// Usage: nur_solver [-threads n] [-max states] [level_name ...]
+//        nur_solver -verify [-moves n] [-threads n] [-max states] [level_name ...]
+//
+// Without level names it solves every level in the package. Solutions are strings of R U L D
+// (moves) and Q E (rotations, the default keys); each letter is one move.
+//
+// With -verify it checks the .nlf files themselves instead (see verify_level()), one level per
+// thread, then with -moves also searches each sound level for a solution of at most n moves. Exits
+// with 1 if any level has a problem.
+//
+// A state is the player's square, every pushable obj (square, kind, dir) in square order and the
+// open/closed bit of every door that can change. pdir isn't part of it: it only changes how the
+// player is drawn. Neither is anything the objs determine: an obj's dir only counts up to the
+// rotations that leave its optics the same, and doors without detectors never change. After each
+// push or rotation the beams and doors run until the doors stop changing. That's where the game
+// settles a few ticks later, well before the player has finished the move; if the player is on red
+// at any point of it, they're dead.
+//
+// Walking doesn't change anything but the player's square, so it isn't searched move by move. A
+// node is a state right after a push or a rotation, and its children are every push and rotation
+// the player can walk to without stepping on red, costing the walk plus one (see solver_expand()).
+// Walking onto a teleporter is a child too. That leaves out all the states where the player is
+// just passing through, which were most of them. A node is dropped when there's one with the same
+// objs and doors that the player could have walked over from for no more moves
+// (solver_is_dominated()).
+//
+// The heuristic (solver_heuristic()) is the larger of two lower bounds: the player's distance to
+// the nearest teleporter on the static map, and for each closed door group that stands between the
+// player and every teleporter, the fewest moves that put a pushable obj in line with one of its
+// detectors and get the player to a door: the walk to the obj, its pushes and rotations, the walks
+// round it to push it another way, and the walk to the door after. Opening a door can drop it by
+// more than a step costs, so a child's f = moves so far + heuristic is never queued below the f
+// being expanded, and a node that turns up again by a shorter path is expanded again. The first goal
+// expanded is a shortest solution. States that can never reach a teleporter are dead.
+//
+// Most states are objs turned every which way next to the player. So each level is searched twice
+// (see solver_solve_level()): first only turning objs a beam ends on, which is quick and finds a
+// solution that isn't always a shortest, then in full, only for solutions shorter than that. When
+// the full search runs out of states, the report gives the first solution as the level's "best",
+// next to how many moves every solution takes at least.
+//
+// Every thread runs its own copy of the simulation: the game's globals are thread_local in this
+// build. The search is synchronous per f. Each thread queues the children it makes in its own
+// buckets, one per f; a pass over f hands every thread its bucket, and a thread that runs out of
+// its own chunks steals from the others'. Children are deduped in a lock-free open-addressing
+// table keyed by a Zobrist hash. Reaching a known state by a shorter path relinks it and queues it
+// again.
+//
+#define HEADLESS 1
+
+#include <string.h>
+#include <pthread.h>
+
+#define ORH_STATIC
+#define ORH_IMPLEMENTATION
+#include "orh.h"
+#include "posix_file.h"
+#include "linux_os.h"
+#include "orh_null.cpp"
+
+#undef  GLOBAL
+#define GLOBAL static thread_local
+#include "game.h"
+#include "game.cpp"
+#undef  GLOBAL
+#define GLOBAL static
+
+#define SOLVER_MAX_KINDS      32
+#define SOLVER_MAX_PIECES     48
+#define SOLVER_MAX_DOORS      256
+#define SOLVER_MAX_GATES      64
+#define SOLVER_MAX_STATE_SIZE (4 + 4*SOLVER_MAX_PIECES + SOLVER_MAX_DOORS/8)
+#define SOLVER_SETTLE_TICKS   16
+#define SOLVER_CHUNK          64
+#define SOLVER_MAX_RING       (1 << 19) // More than LEVEL_MAX_SQUARES + 2; see solver_prepare_level().
+#define SOLVER_DEFAULT_MAX_NODES (1 << 25)
+
+#define VERIFY_FIRST_LEVEL 4 // Skip invalid_level and aaa_placeholders.
+
+enum Solver_Action
+{
+    SolverAction_RIGHT,
+    SolverAction_UP,
+    SolverAction_LEFT,
+    SolverAction_DOWN,
+    SolverAction_CCW,
+    SolverAction_CW,
+    SolverAction_TELEPORT, // Walked onto a teleporter.
+    
+    SolverAction_COUNT,
+};
+GLOBAL char solver_action_letters[] = "RULDQE";
+GLOBAL V2s  solver_action_dirs[]    = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+
+// Pushable objs that share type, flags and color are interchangeable.
+struct Solver_Kind
+{
+    u8 type, flags, c;
+    u8 dirs; // dir and dir+dirs trace beams the same way.
+};
+
+struct Solver_Piece
+{
+    u16 square;
+    u8  kind;
+    u8  dir;
+};
+
+// A door group that can change, for the heuristic.
+struct Solver_Gate
+{
+    s32 first_door; // In Solver_Level::doors.
+    s32 doors_count;
+    u16 *costs;     // [kind*8 + dir][square*5 + next push or 4] See solver_push_costs(); 0 in the last slot if such an obj is in place.
+    u16 exit;       // Fewest moves from any of its doors to a teleporter.
+};
+
+// State layout: u32 player square, Solver_Piece[pieces_count], door bits (padded to 4 bytes).
+//
+struct Solver_Level
+{
+    s32 idx;
+    s32 squares;
+    
+    Solver_Kind kinds[SOLVER_MAX_KINDS];
+    s32 kinds_count;
+    s32 pieces_count;
+    
+    u16 doors[SOLVER_MAX_DOORS];
+    s32 doors_count;
+    
+    Solver_Gate gates[SOLVER_MAX_GATES];
+    s32 gates_count;
+    
+    s32 state_size;
+    u8 *base; // The level's obj planes with the pushable objs taken out.
+    u16 *distance; // [square] Fewest moves to a teleporter on the static map, or U16_MAX.
+    u64 *gated;    // [square] Gates the player has to get through to reach any teleporter from there.
+    u32 max_heuristic; // solver_heuristic() is never more, short of U16_MAX.
+    u32 ring_mask; // Buckets per thread - 1.
+    
+    u64 *zobrist_pieces; // [square][kind*8 + dir]
+    u64 *zobrist_player; // [square]
+    u64 *zobrist_doors;  // [door]
+};
+
+struct Verify_Level
+{
+    b32 wanted;
+    b32 checked;
+    s32 squares;
+    s32 lasers;
+    s32 detectors;
+    s32 doors;
+    
+    Arena *arena;
+    Array<String8> problems;
+};
+
+struct Solver_Chunk
+{
+    Solver_Chunk *next;
+    u32 count;
+    u32 nodes[SOLVER_CHUNK];
+    u32 g[SOLVER_CHUNK]; // The node's g when it was queued.
+};
+
+// solver_walk(): squares in the order they're reached, and the distance and the action that got
+// there for the squares whose `seen` is `stamp`.
+struct Solver_Walk
+{
+    u16 *queue;
+    u16 *distance;
+    u8  *from;
+    u32 *seen;
+    u32 *red; // `stamp` if a beam with red in it lights the square.
+    u32 *hit; // `stamp` if a beam ends on the square.
+    u32  stamp;
+    s32  count;
+};
+
+struct Solver_Thread
+{
+    Arena *arena;           // Chunks; reset for every level.
+    Solver_Chunk *free;     // Chunks that have been expanded, to reuse.
+    Solver_Chunk **buckets; // [f & ring_mask] Chunks this thread queued for f, newest first.
+    Solver_Chunk *work;     // Chunks of the current pass. Any thread can take them.
+    
+    Solver_Walk walk;       // From the node being expanded.
+    Solver_Walk child_walk; // From the child being added.
+};
+
+struct Solver
+{
+    s32 threads_count;
+    u32 max_nodes;
+    s32 max_depth; // 0 for no limit.
+    b32 hit_rotations; // Only rotate objs a beam ends on; see solver_solve_level().
+    pthread_barrier_t barrier;
+    b32 quit;
+    
+    Level_Manifest manifest;
+    Level_Package package;
+    Arena *level_arena;
+    Solver_Level level;
+    Solver_Thread *threads;
+    
+    // Nodes; links give the path back to the root (see solver_link()).
+    u8  *states;
+    u64 *hashes;
+    u64 *links;
+    u32  nodes_count;
+    
+    // Visited set: node+1 per slot, 0 if empty.
+    u32 *table;
+    u64  table_mask;
+    
+    // Smallest g+1 of the nodes with a given hash of the objs and doors alone, 0 if none; bounds
+    // how far solver_is_dominated() has to look.
+    u32 *configs;
+    u64  configs_mask;
+    
+    s32 depth; // f of the nodes being expanded; no solution is shorter than that.
+    s32 found; // Goal node, or -1.
+    b32 overflow;
+    b32 done;
+    
+    // -verify: every thread takes levels off verify_cursor.
+    b32 verifying;
+    s32 verify_cursor;
+    Verify_Level *verified;
+};
+GLOBAL Solver solver;
+GLOBAL thread_local Solver_Thread *solver_thread;
+
+FUNCTION void* solver_reserve(u64 size)
+{
+    // Committed up front; Linux only backs the pages that get touched.
+    void *result = linux_reserve(size);
+    if (result) linux_commit(result, size);
+    return result;
+}
+
+FUNCTION void solver_clear(void *memory, u64 size)
+{
+    // Hands the pages back so they read as zeroes again, without touching them.
+    linux_decommit(memory, size);
+    linux_commit(memory, size);
+}
+
+FUNCTION void solver_thread_init(s32 thread)
+{
+    // @Note: Same setup game_init() does for the level, in this thread's copy of the globals. The
+    // permanent arena belongs to the main thread, so each thread brings its own.
+    //
+    solver_thread = &solver.threads[thread];
+    if (!thread)
+        return;
+    
+    Arena *arena             = arena_init(MEGABYTES(1));
+    game                     = PUSH_STRUCT_ZERO(arena, Game_State);
+    game->package            = solver.package;
+    manifest                 = solver.manifest;
+    game->loaded_level_arena = arena_init(MEGABYTES(1));
+    undo_handler_init(&undo_handler);
+}
+
+FUNCTION b32 solver_settle()
+{
+    // Returns whether the player was on red on any tick; the game kills them on the first one.
+    b32 result = FALSE;
+    for (s32 i = 0; i < SOLVER_SETTLE_TICKS; i++) {
+        obj_index_update(&obj_index);
+        beams_update(&beam_tracer);
+        result |= (pcolor & Color_RED) != 0;
+        
+        b32 opened = FALSE, closed = FALSE;
+        door_index_update(&door_index, &opened, &closed);
+        if (!opened && !closed)
+            break;
+    }
+    return result;
+}
+
+FUNCTION b32 solver_is_pushable(u8 type)
+{
+    b32 result = (type == T_MIRROR || type == T_BENDER || type == T_SPLITTER);
+    return result;
+}
+
+FUNCTION u8 solver_optics_dirs(u8 type)
+{
+    // The smallest rotation that leaves the obj's optics the same.
+    u8 result = 1;
+    for (; result < 8; result *= 2) {
+        b32 same = TRUE;
+        for (s32 d = 0; d < 8; d++) {
+            for (s32 src_d = 0; src_d < 8; src_d++) {
+                Beam_Optics a = beam_optics.e[type][d][src_d];
+                Beam_Optics b = beam_optics.e[type][WRAP_D(d + result)][src_d];
+                same &= (a.reflected == b.reflected && a.penetrate == b.penetrate);
+            }
+        }
+        if (same)
+            break;
+    }
+    return result;
+}
+
+FUNCTION s32 solver_find_kind(Solver_Level *level, u8 type, u8 flags, u8 c)
+{
+    for (s32 i = 0; i < level->kinds_count; i++) {
+        Solver_Kind k = level->kinds[i];
+        if (k.type == type && k.flags == flags && k.c == c)
+            return i;
+    }
+    return -1;
+}
+
+FUNCTION u32 solver_get_player(u8 *state)
+{
+    u32 result = 0;
+    MEMORY_COPY(&result, state, sizeof(u32));
+    return result;
+}
+
+FUNCTION u64 solver_get_state(Solver_Level *level, u8 *state)
+{
+    // Reads the live world into `state` and returns its hash.
+    //
+    MEMORY_ZERO(state, level->state_size);
+    
+    u32 player    = (u32)MAP_IDX(px, py);
+    MEMORY_COPY(state, &player, sizeof(u32));
+    u64 result    = level->zobrist_player[player];
+    
+    Solver_Piece *pieces = (Solver_Piece *)(state + 4);
+    s32 count = 0;
+    for (s32 i = 0; i < level->squares; i++) {
+        if (!solver_is_pushable(objmap.type[i]))
+            continue;
+        
+        Solver_Piece p = {};
+        p.square = (u16)i;
+        p.kind   = (u8)solver_find_kind(level, objmap.type[i], objmap.flags[i], objmap.c[i]);
+        p.dir    = objmap.dir[i] % level->kinds[p.kind].dirs;
+        pieces[count++] = p;
+        result ^= level->zobrist_pieces[i*level->kinds_count*8 + p.kind*8 + p.dir];
+    }
+    ASSERT(count == level->pieces_count);
+    
+    u8 *doors = (u8 *)(pieces + level->pieces_count);
+    for (s32 i = 0; i < level->doors_count; i++) {
+        if (objmap.type[level->doors[i]] == T_DOOR_OPEN) {
+            doors[i/8] |= (u8)(1 << (i%8));
+            result ^= level->zobrist_doors[i];
+        }
+    }
+    
+    return result;
+}
+
+FUNCTION void solver_set_state(Solver_Level *level, u8 *state)
+{
+    MEMORY_COPY(objmap.type, level->base, 12*level->squares);
+    
+    Solver_Piece *pieces = (Solver_Piece *)(state + 4);
+    for (s32 i = 0; i < level->pieces_count; i++) {
+        Solver_Piece p = pieces[i];
+        Solver_Kind  k = level->kinds[p.kind];
+        objmap.type [p.square] = k.type;
+        objmap.flags[p.square] = k.flags;
+        objmap.c    [p.square] = k.c;
+        objmap.dir  [p.square] = p.dir;
+    }
+    
+    u8 *doors = (u8 *)(pieces + level->pieces_count);
+    for (s32 i = 0; i < level->doors_count; i++)
+        objmap.type[level->doors[i]] = ((doors[i/8] >> (i%8)) & 1)? (u8)T_DOOR_OPEN : (u8)T_DOOR;
+    
+    u32 player = solver_get_player(state);
+    set_player_position((s32)player % objmap.pitch, (s32)player / objmap.pitch, pdir, TRUE);
+    
+    obj_index.rebuild  = TRUE;
+    door_index.rebuild = TRUE;
+    beams_mark_all_dirty(&beam_tracer);
+}
+
+FUNCTION void solver_restore_doors(Solver_Level *level, u8 *state)
+{
+    u8 *doors = state + 4 + 4*level->pieces_count;
+    for (s32 i = 0; i < level->doors_count; i++) {
+        s32 j   = level->doors[i];
+        u8 type = ((doors[i/8] >> (i%8)) & 1)? (u8)T_DOOR_OPEN : (u8)T_DOOR;
+        if (objmap.type[j] != type) {
+            objmap.type[j] = type;
+            beams_mark_dirty(&beam_tracer, j % objmap.pitch, j / objmap.pitch);
+        }
+    }
+}
+
+FUNCTION u32 solver_heuristic(Solver_Level *level, u8 *state)
+{
+    // @Note: A door is only open while one of its group's detectors is lit, and the last stretch
+    // of that beam starts at something on one of the 8 lines out of the detector that turns it that
+    // way. So while every door of a gate between the player and the teleporters is closed, the
+    // player has yet to step into one of them with some obj on such a line, facing the detector:
+    // first the walk to the obj, then the pushes and rotations that get it there (each moves or
+    // turns it one step) and the walks round it in between, then the step, then the rest of the
+    // way from the door. Gates with a laser pointing down one of those lines were left out.
+    // U16_MAX if the state can't reach a teleporter at all.
+    //
+    u32 player = solver_get_player(state);
+    u32 result = level->distance[player];
+    if (result == U16_MAX)
+        return result;
+    s32 x = (s32)player % objmap.pitch;
+    s32 y = (s32)player / objmap.pitch;
+    
+    Solver_Piece *pieces = (Solver_Piece *)(state + 4);
+    u8 *doors            = (u8 *)(pieces + level->pieces_count);
+    for (u64 gated = level->gated[player]; gated; gated &= gated - 1) {
+        Solver_Gate *gate = &level->gates[__builtin_ctzll(gated)];
+        
+        b32 open = FALSE;
+        for (s32 i = gate->first_door; i < gate->first_door + gate->doors_count; i++)
+            open |= (doors[i/8] >> (i%8)) & 1;
+        if (open)
+            continue;
+        
+        u32 cost = U16_MAX;
+        for (s32 i = 0; i < level->pieces_count; i++) {
+            u16 *costs = gate->costs + ((pieces[i].kind*8 + pieces[i].dir)*level->squares + pieces[i].square)*5;
+            if (!costs[4]) {
+                cost = 0;
+                break;
+            }
+            
+            // Pushing it means standing behind it; only turning it, standing next to it.
+            s32 dx = pieces[i].square % objmap.pitch - x;
+            s32 dy = pieces[i].square / objmap.pitch - y;
+            for (s32 a = 0; a < 4; a++) {
+                if (costs[a] != U16_MAX)
+                    cost = MIN(cost, (u32)(costs[a] + ABS(dx - solver_action_dirs[a].x) + ABS(dy - solver_action_dirs[a].y)));
+            }
+            if (costs[4] != U16_MAX)
+                cost = MIN(cost, (u32)(costs[4] + CLAMP_LOWER(ABS(dx) - 1, 0) + CLAMP_LOWER(ABS(dy) - 1, 0)));
+        }
+        if (cost == U16_MAX)
+            return U16_MAX;
+        result = MAX(result, cost + gate->exit);
+    }
+    result = MIN(result, level->max_heuristic);
+    return result;
+}
+
+// @Note: A node's link packs everything that changes when a shorter path to it turns up, so one
+// compare-and-swap replaces it: moves from the root << 40 | action << 32 | parent. The action is
+// the push, rotation or teleport that ended the step; the walk before it is found again when the
+// solution is printed.
+//
+FUNCTION u64 solver_link(u32 g, u8 action, u32 parent)
+{
+    u64 result = ((u64)g << 40) | ((u64)action << 32) | parent;
+    return result;
+}
+FUNCTION u32 solver_link_g(u64 link)      { return (u32)(link >> 40); }
+FUNCTION u8  solver_link_action(u64 link) { return (u8)(link >> 32); }
+FUNCTION u32 solver_link_parent(u64 link) { return (u32)link; }
+
+FUNCTION s64 solver_insert(u8 *state, u64 hash, u64 link)
+{
+    // @Note: Returns the node if the state is new or `link` is a shorter path to it, -1 if not or
+    // if we ran out of nodes. A node is filled in before it's published to the table, so anyone
+    // who finds it can read it.
+    //
+    s32 size = solver.level.state_size;
+    s64 node = -1;
+    
+    u64 i = hash & solver.table_mask;
+    for (u64 probes = 0; probes <= solver.table_mask; probes++, i = (i + 1) & solver.table_mask) {
+        u32 slot = __atomic_load_n(&solver.table[i], __ATOMIC_ACQUIRE);
+        if (!slot) {
+            if (node < 0) {
+                node = __atomic_fetch_add(&solver.nodes_count, 1, __ATOMIC_RELAXED);
+                if (node >= solver.max_nodes) {
+                    __atomic_store_n(&solver.overflow, TRUE, __ATOMIC_RELAXED);
+                    return -1;
+                }
+                MEMORY_COPY(solver.states + node*size, state, size);
+                solver.hashes[node] = hash;
+                solver.links [node] = link;
+            }
+            
+            if (__atomic_compare_exchange_n(&solver.table[i], &slot, (u32)node + 1, FALSE, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+                return node;
+            
+            // Someone else took the slot; slot now holds their node.
+        }
+        
+        u32 other = slot - 1;
+        if (solver.hashes[other] == hash && memcmp(solver.states + (u64)other*size, state, size) == 0) {
+            u64 old = __atomic_load_n(&solver.links[other], __ATOMIC_RELAXED);
+            while (solver_link_g(link) < solver_link_g(old)) {
+                if (__atomic_compare_exchange_n(&solver.links[other], &old, link, FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                    return other;
+            }
+            return -1;
+        }
+    }
+    
+    __atomic_store_n(&solver.overflow, TRUE, __ATOMIC_RELAXED);
+    return -1;
+}
+
+FUNCTION u32* solver_config(u8 *state, u64 hash)
+{
+    u32 *result = &solver.configs[(hash ^ solver.level.zobrist_player[solver_get_player(state)]) & solver.configs_mask];
+    return result;
+}
+
+FUNCTION u32 solver_config_reach(u8 *state, u64 hash, u32 g)
+{
+    // How far from the player a node with the same objs and doors and a g small enough to
+    // dominate one with `g` could be; 0 if there can't be one.
+    u32 config = __atomic_load_n(solver_config(state, hash), __ATOMIC_RELAXED);
+    u32 result = (config && config - 1 < g)? g - (config - 1) : 0;
+    return result;
+}
+
+FUNCTION s64 solver_find(u8 *state, u64 hash)
+{
+    // The node of `state`, or -1.
+    s32 size = solver.level.state_size;
+    u64 i    = hash & solver.table_mask;
+    for (u64 probes = 0; probes <= solver.table_mask; probes++, i = (i + 1) & solver.table_mask) {
+        u32 slot = __atomic_load_n(&solver.table[i], __ATOMIC_ACQUIRE);
+        if (!slot)
+            break;
+        
+        u32 other = slot - 1;
+        if (solver.hashes[other] == hash && memcmp(solver.states + (u64)other*size, state, size) == 0)
+            return other;
+    }
+    return -1;
+}
+
+FUNCTION void solver_queue(u32 node, u32 g, u32 f)
+{
+    // Only this thread adds to its buckets, and the bucket for the f being expanded was handed to
+    // the pass when it started, so nothing here is shared.
+    Solver_Thread *t      = solver_thread;
+    Solver_Chunk **bucket = &t->buckets[f & solver.level.ring_mask];
+    Solver_Chunk *chunk   = *bucket;
+    if (!chunk || chunk->count == SOLVER_CHUNK) {
+        chunk = t->free;
+        if (chunk)
+            t->free = chunk->next;
+        else
+            chunk = PUSH_STRUCT(t->arena, Solver_Chunk);
+        chunk->next  = *bucket;
+        chunk->count = 0;
+        *bucket      = chunk;
+    }
+    chunk->nodes[chunk->count] = node;
+    chunk->g    [chunk->count] = g;
+    chunk->count++;
+}
+
+FUNCTION Solver_Chunk* solver_take_chunk(Solver_Thread *from)
+{
+    // @Note: Nothing is added to a work list during a pass, so a chunk can't come back to the head
+    // while someone's compare-and-swap is in flight, and a stale `next` only makes it fail.
+    //
+    Solver_Chunk *result = __atomic_load_n(&from->work, __ATOMIC_ACQUIRE);
+    while (result && !__atomic_compare_exchange_n(&from->work, &result, result->next, FALSE, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {}
+    return result;
+}
+
+FUNCTION b32 solver_next_pass()
+{
+    // Runs on thread 0 between passes. Moves on to the nodes queued for the same f if there are
+    // any, else to the smallest f anything was queued for, and hands every thread its bucket.
+    // Children are queued less than the ring's size past the f of their parent (see
+    // solver_prepare_level()), so it has room for all of them.
+    //
+    s32 next = -1;
+    for (s32 f = solver.depth; next < 0 && f <= solver.depth + (s32)solver.level.ring_mask; f++) {
+        for (s32 i = 0; i < solver.threads_count; i++) {
+            if (solver.threads[i].buckets[f & solver.level.ring_mask]) {
+                next = f;
+                break;
+            }
+        }
+    }
+    if (next < 0 || (solver.max_depth && next > solver.max_depth))
+        return FALSE;
+    
+    solver.depth = next;
+    for (s32 i = 0; i < solver.threads_count; i++) {
+        Solver_Chunk **bucket  = &solver.threads[i].buckets[next & solver.level.ring_mask];
+        solver.threads[i].work = *bucket;
+        *bucket                = 0;
+    }
+    return TRUE;
+}
+
+FUNCTION b32 solver_can_rotate(s32 x, s32 y, b32 any = FALSE, Solver_Walk *hit = 0)
+{
+    // Whether rotate_objs_around_player() would turn anything with the player on [x,y], or with
+    // `any`, whether there's a pushable obj around at all. With `hit`, only objs a beam ends on
+    // in that walk's world count.
+    for (s32 dy = CLAMP_LOWER(y-1, 0); dy <= CLAMP_UPPER(objmap.rows-1, y+1); dy++) {
+        for (s32 dx = CLAMP_LOWER(x-1, 0); dx <= CLAMP_UPPER(objmap.pitch-1, x+1); dx++) {
+            s32 i = MAP_IDX(dx, dy);
+            if (solver_is_pushable(objmap.type[i]) && (any || !is_set(objmap.flags[i], ObjFlags_NEVER_ROTATE)) && (!hit || hit->hit[i] == hit->stamp))
+                return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+FUNCTION void solver_walk(Solver_Walk *walk, u32 from)
+{
+    // @Note: Breadth-first from `from` over the squares the player can walk to in the settled
+    // world without pushing or rotating anything: not into walls, lasers, closed doors or pushable
+    // objs, and not onto red. A teleporter ends the walk, red or not.
+    //
+    u32 stamp = ++walk->stamp;
+    
+    // Mixing only gives red if something red goes in, so the other squares don't need mixing.
+    for (s32 i = 0; i < solver.level.squares; i++) {
+        for (s32 j = beam_tracer.first_segment[i]; j >= 0; j = beam_tracer.segments[j].next) {
+            Beam_Segment *segment = &beam_tracer.segments[j];
+            V2s d = dirs[segment->dir];
+            s32 x = segment->x + segment->lit_length*d.x;
+            s32 y = segment->y + segment->lit_length*d.y;
+            if (!is_outside_map(x, y))
+                walk->hit[MAP_IDX(x, y)] = stamp;
+            if (!(segment->color & Color_RED))
+                continue;
+            
+            for (s32 k = 1; k <= segment->lit_length && !is_outside_map(segment->x + k*d.x, segment->y + k*d.y); k++)
+                walk->red[MAP_IDX(segment->x + k*d.x, segment->y + k*d.y)] = stamp;
+        }
+    }
+    
+    walk->queue[0]       = (u16)from;
+    walk->seen[from]     = stamp;
+    walk->distance[from] = 0;
+    walk->count          = 1;
+    for (s32 q = 0; q < walk->count; q++) {
+        s32 i = walk->queue[q];
+        if (objmap.type[i] == T_TELEPORTER)
+            continue;
+        
+        s32 x = i % objmap.pitch;
+        s32 y = i / objmap.pitch;
+        for (s32 a = 0; a < SolverAction_CCW; a++) {
+            s32 nx = x + solver_action_dirs[a].x;
+            s32 ny = y + solver_action_dirs[a].y;
+            if (player_collides(nx, ny))
+                continue;
+            
+            s32 n = MAP_IDX(nx, ny);
+            if (walk->seen[n] == stamp || solver_is_pushable(objmap.type[n]))
+                continue;
+            walk->seen[n] = stamp;
+            if (objmap.type[n] != T_TELEPORTER && walk->red[n] == stamp && (beams_color_at(&beam_tracer, nx, ny) & Color_RED))
+                continue;
+            
+            walk->distance[n]           = walk->distance[i] + 1;
+            walk->from[n]               = (u8)a;
+            walk->queue[walk->count++]  = (u16)n;
+        }
+    }
+}
+
+FUNCTION b32 solver_is_dominated(Solver_Walk *walk, u8 *state, u64 hash, u32 g, u32 reach)
+{
+    // @Note: Whether there's a node with the same objs and doors as `state` but the player
+    // somewhere else on `walk` (which starts on the player's square), and walking from there is no
+    // longer than the g we have. That node has every child this one would have, for no more moves.
+    // It's expanded no later than this one, since its g is smaller and the heuristic drops by at
+    // most a step per step; and walks go both ways, so two nodes can't leave each other out.
+    // Trashes `state`'s player square.
+    //
+    // Nodes other than the root and the goal have the player next to a pushable obj, since they
+    // come right after a push or a rotation. The walk is in order of distance; `reach` is from
+    // solver_config_reach().
+    //
+    Solver_Level *level = &solver.level;
+    u32 player          = solver_get_player(state);
+    for (s32 q = 1; q < walk->count && walk->distance[walk->queue[q]] <= reach; q++) {
+        u32 other = walk->queue[q];
+        if (objmap.type[other] == T_TELEPORTER || !solver_can_rotate(other % objmap.pitch, other / objmap.pitch, TRUE))
+            continue;
+        
+        MEMORY_COPY(state, &other, sizeof(u32));
+        s64 node = solver_find(state, hash ^ level->zobrist_player[player] ^ level->zobrist_player[other]);
+        if (node >= 0 && solver_link_g(__atomic_load_n(&solver.links[node], __ATOMIC_RELAXED)) + walk->distance[other] <= g)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+FUNCTION void solver_add_child(u8 *state, u64 hash, u32 g, u8 action, u32 parent)
+{
+    // The heuristic can drop by more than a move costs when a door opens, so a child can come out
+    // below the f being expanded; it's queued for this one then (and its own children can't be
+    // shorter than that either).
+    u32 h = solver_heuristic(&solver.level, state);
+    u32 f = MAX(g + h, (u32)solver.depth);
+    if (h == U16_MAX || (solver.max_depth && f > (u32)solver.max_depth))
+        return;
+    
+    s64 child = solver_insert(state, hash, solver_link(g, action, parent));
+    if (child >= 0) {
+        u32 *config = solver_config(state, hash);
+        u32  old    = __atomic_load_n(config, __ATOMIC_RELAXED);
+        while ((!old || g + 1 < old) && !__atomic_compare_exchange_n(config, &old, g + 1, FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+        solver_queue((u32)child, g, f);
+    }
+}
+
+FUNCTION void solver_expand(u32 node, u32 queued_g)
+{
+    Solver_Level *level = &solver.level;
+    Solver_Thread *t    = solver_thread;
+    u8 *parent_state    = solver.states + (u64)node*level->state_size;
+    u8 state[SOLVER_MAX_STATE_SIZE];
+    
+    // A node is queued again when a shorter path to it turns up; the old entry is stale.
+    u32 g = solver_link_g(__atomic_load_n(&solver.links[node], __ATOMIC_RELAXED));
+    if (g != queued_g)
+        return;
+    
+    u32 player = solver_get_player(parent_state);
+    if (level->distance[player] == 0) {
+        s32 expected = -1;
+        __atomic_compare_exchange_n(&solver.found, &expected, (s32)node, FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        return;
+    }
+    
+    solver_set_state(level, parent_state);
+    solver_settle();
+    solver_walk(&t->walk, player);
+    
+    // Somebody else may have come along since this node was added.
+    MEMORY_COPY(state, parent_state, level->state_size);
+    u32 reach = solver_config_reach(state, solver.hashes[node], g);
+    if (reach && solver_is_dominated(&t->walk, state, solver.hashes[node], g, reach))
+        return;
+    
+    // @Note: Pushes and rotations go through the undo log, so getting back to the parent only
+    // retraces the beams they touched, the same as undoing in the game. The walk is done first:
+    // the beams aren't traced again until the next settle.
+    //
+    for (s32 q = 0; q < t->walk.count; q++) {
+        s32 square = t->walk.queue[q];
+        s32 x      = square % objmap.pitch;
+        s32 y      = square / objmap.pitch;
+        u32 walked = g + t->walk.distance[square];
+        
+        if (objmap.type[square] == T_TELEPORTER) {
+            u32 to = (u32)square;
+            MEMORY_COPY(state, parent_state, level->state_size);
+            MEMORY_COPY(state, &to, sizeof(u32));
+            u64 hash = solver.hashes[node] ^ level->zobrist_player[player] ^ level->zobrist_player[to];
+            solver_add_child(state, hash, walked, SolverAction_TELEPORT, node);
+            continue;
+        }
+        
+        b32 can_rotate = solver_can_rotate(x, y, FALSE, solver.hit_rotations? &t->walk : 0);
+        for (s32 a = 0; a < SolverAction_TELEPORT; a++) {
+            if (a < SolverAction_CCW) {
+                s32 nx = x + solver_action_dirs[a].x;
+                s32 ny = y + solver_action_dirs[a].y;
+                if (is_outside_map(nx, ny) || !solver_is_pushable(objmap.type[MAP_IDX(nx, ny)]))
+                    continue;
+            } else if (!can_rotate) {
+                continue;
+            }
+            
+            set_player_position(x, y, pdir, TRUE);
+            b32 changed = FALSE;
+            if (a < SolverAction_CCW)
+                changed = move_player(solver_action_dirs[a].x, solver_action_dirs[a].y);
+            else
+                changed = rotate_objs_around_player(a == SolverAction_CCW) > 0;
+            if (!changed)
+                continue;
+            undo_end_frame(&undo_handler);
+            
+            if (!solver_settle()) {
+                // Walking only for the children that might be dominated.
+                u64 hash       = solver_get_state(level, state);
+                u32 reach      = solver_config_reach(state, hash, walked + 1);
+                b32 dominated  = FALSE;
+                if (reach) {
+                    u8 copy[SOLVER_MAX_STATE_SIZE];
+                    MEMORY_COPY(copy, state, level->state_size);
+                    solver_walk(&t->child_walk, MAP_IDX(px, py));
+                    dominated = solver_is_dominated(&t->child_walk, copy, hash, walked + 1, reach);
+                }
+                if (!dominated)
+                    solver_add_child(state, hash, walked + 1, (u8)a, node);
+            }
+            
+            undo_next(&undo_handler);
+            solver_restore_doors(level, parent_state);
+        }
+    }
+}
+
+FUNCTION b32 solver_should_stop()
+{
+    b32 result = (__atomic_load_n(&solver.found, __ATOMIC_RELAXED) >= 0 || __atomic_load_n(&solver.overflow, __ATOMIC_RELAXED));
+    return result;
+}
+
+FUNCTION void solver_search(s32 thread)
+{
+    // @Note: Run by every thread for each level, between the barrier that starts it and the one
+    // that ends it. A thread expands its own chunks of the pass first, then goes round the others
+    // taking theirs; work lists only shrink during a pass, so one that's empty stays empty. Thread
+    // 0 sets up the next pass while the others wait.
+    //
+    // -verify rebuilds the package after the threads have started.
+    if (thread) {
+        game->package = solver.package;
+        load_level(solver.level.idx);
+    }
+    
+    for (;;) {
+        for (s32 i = 0; i < solver.threads_count && !solver_should_stop(); i++) {
+            Solver_Thread *from = &solver.threads[(thread + i) % solver.threads_count];
+            for (Solver_Chunk *chunk = solver_take_chunk(from); chunk; chunk = solver_take_chunk(from)) {
+                for (u32 j = 0; j < chunk->count; j++)
+                    solver_expand(chunk->nodes[j], chunk->g[j]);
+                
+                chunk->next         = solver_thread->free;
+                solver_thread->free = chunk;
+                if (solver_should_stop())
+                    break;
+            }
+        }
+        pthread_barrier_wait(&solver.barrier);
+        
+        // Every node queued for this f is as short as the goal, so stop as soon as there is one.
+        // Only set here: once thread 0 is out it may prepare the next search before the others
+        // have read it.
+        if (thread == 0)
+            solver.done = (solver.found >= 0 || solver.overflow || !solver_next_pass());
+        pthread_barrier_wait(&solver.barrier);
+        
+        if (solver.done)
+            break;
+    }
+}
+
+////////////////////////////////
+// Verifier.
+//
+GLOBAL char *verify_obj_names[]   = {"empty", "laser", "mirror", "bender", "splitter", "detector", "door", "open door", "teleporter"};
+GLOBAL char *verify_color_names[] = {"white", "red", "green", "yellow", "blue", "magenta", "cyan", "black"};
+
+FUNCTION void verify_level(s32 idx, Verify_Level *v)
+{
+    // @Note: Checks the .nlf on disk rather than the package, since that's what ships. Runs on any
+    // solver thread, in that thread's copy of the game.
+    //
+    String8 name = manifest.levels[idx].name;
+    v->arena     = arena_init(MEGABYTES(1));
+    v->checked   = TRUE;
+    array_init(&v->problems);
+    
+    Arena_Temp scratch = get_scratch(0, 0);
+    defer(free_scratch(scratch));
+    
+    String8 file = os->map_file(sprint(scratch.arena, "%Slevels/%S.nlf", os->data_folder, name));
+    if (!file.data) {
+        array_add(&v->problems, sprint(v->arena, "%S.nlf is missing", name));
+        return;
+    }
+    defer(os->unmap_file(file));
+    
+    Loaded_Level *lev = &game->loaded_level;
+    MEMORY_ZERO_STRUCT(lev);
+    arena_reset(game->loaded_level_arena);
+    if (!parse_level(file, name, lev, game->loaded_level_arena)) {
+        array_add(&v->problems, sprint(v->arena, "%S.nlf is corrupted or has invalid dimensions (at most %d squares)", name, LEVEL_MAX_SQUARES));
+        return;
+    }
+    if (lev->idx != idx)
+        array_add(&v->problems, sprint(v->arena, "the file says id %d, levels.txt says %d", lev->idx, idx));
+    
+    Player p = lev->player;
+    if (p.x < 0 || p.x >= lev->num_x*lev->size_x || p.y < 0 || p.y >= lev->num_y*lev->size_y) {
+        array_add(&v->problems, sprint(v->arena, "the player starts outside the level at (%d, %d)", p.x, p.y));
+        return;
+    }
+    
+    reload_map();
+    
+    // Squares.
+    v->squares = objmap.pitch*objmap.rows;
+    s32 teleporters = 0;
+    b32 valid       = TRUE;
+    for (s32 i = 0; i < v->squares; i++) {
+        s32 x     = i % objmap.pitch;
+        s32 y     = i / objmap.pitch;
+        u8 type   = objmap.type[i];
+        u8 *color = &objmap.color[i*8];
+        if (tilemap[i] > Tile_WALL || type >= T_COUNT) {
+            array_add(&v->problems, sprint(v->arena, "(%d, %d): unknown tile %d or obj %d", x, y, tilemap[i], type));
+            valid = FALSE;
+            continue;
+        }
+        
+        // Doors keep a detector count in color[0]; everywhere else it's a color like the rest.
+        b32 bad_color = objmap.dir[i] >= 8 || objmap.c[i] >= 8;
+        for (s32 d = (type == T_DOOR || type == T_DOOR_OPEN)? 2 : 0; d < 8; d++)
+            bad_color |= color[d] >= 8;
+        if (bad_color) {
+            array_add(&v->problems, sprint(v->arena, "(%d, %d): %s has an invalid dir or color", x, y, verify_obj_names[type]));
+            valid = FALSE;
+        }
+        
+        if (type != T_EMPTY && tilemap[i] == Tile_WALL)
+            array_add(&v->problems, sprint(v->arena, "(%d, %d): %s is embedded in a wall", x, y, verify_obj_names[type]));
+        
+        switch (type) {
+            case T_LASER:      v->lasers++;    break;
+            case T_DETECTOR:   v->detectors++; break;
+            case T_DOOR:
+            case T_DOOR_OPEN:  v->doors++;     break;
+            case T_TELEPORTER: teleporters++;  break;
+        }
+    }
+    if (!teleporters)
+        array_add(&v->problems, sprint(v->arena, "there's no teleporter"));
+    if (player_collides(px, py))
+        array_add(&v->problems, sprint(v->arena, "the player starts inside a wall or an obj at (%d, %d)", px, py));
+    
+    // The beams index the color mixing tables with these.
+    if (!valid)
+        return;
+    
+    // Doors.
+    door_index_build(&door_index);
+    for (s32 g = 0; g < door_index.groups_count; g++) {
+        Door_Group group = door_index.groups[g];
+        for (s32 i = group.first_door; i < group.first_door + group.doors_count; i++) {
+            V2s door     = door_index.doors[i];
+            s32 required = MAX(objmap.color[MAP_IDX(door.x, door.y)*8], 1);
+            if (required > group.detectors_count) {
+                array_add(&v->problems, sprint(v->arena, "(%d, %d): %s door needs %d detectors, its room has %d",
+                                               door.x, door.y, verify_color_names[group.c], required, group.detectors_count));
+            }
+        }
+    }
+    
+    // Beams, from the start position.
+    b32 settled = FALSE;
+    for (s32 i = 0; i < SOLVER_SETTLE_TICKS && !settled; i++) {
+        obj_index_update(&obj_index);
+        beams_update(&beam_tracer);
+        
+        b32 opened = FALSE, closed = FALSE;
+        door_index_update(&door_index, &opened, &closed);
+        settled = !opened && !closed;
+    }
+    if (!settled)
+        array_add(&v->problems, sprint(v->arena, "doors keep opening and closing at the start"));
+    if (pcolor & Color_RED)
+        array_add(&v->problems, sprint(v->arena, "the player starts in a red beam"));
+}
+
+FUNCTION void verify_levels()
+{
+    for (;;) {
+        s32 idx = __atomic_fetch_add(&solver.verify_cursor, 1, __ATOMIC_RELAXED);
+        if (idx >= manifest.levels_count)
+            break;
+        if (solver.verified[idx].wanted)
+            verify_level(idx, &solver.verified[idx]);
+    }
+}
+
+FUNCTION void* solver_worker(void *param)
+{
+    s32 thread = (s32)(s64)param;
+    solver_thread_init(thread);
+    
+    for (;;) {
+        pthread_barrier_wait(&solver.barrier);
+        if (solver.quit)
+            break;
+        
+        if (solver.verifying) {
+            verify_levels();
+            pthread_barrier_wait(&solver.barrier);
+        } else {
+            solver_search(thread);
+        }
+    }
+    
+    return 0;
+}
+
+FUNCTION b32 solver_player_can_stand(s32 i)
+{
+    // On the static map: walls, lasers and doors that never open are in the way.
+    u8 type     = objmap.type[i];
+    b32 result  = (tilemap[i] != Tile_WALL && type != T_LASER);
+    if (type == T_DOOR) {
+        result = FALSE;
+        for (s32 d = 0; d < solver.level.doors_count; d++)
+            result |= (solver.level.doors[d] == i);
+    }
+    return result;
+}
+
+FUNCTION b32 solver_obj_can_stand(s32 i)
+{
+    // Squares move_obj() can put a pushable obj on, besides the ones other objs are on.
+    u8 type    = objmap.type[i];
+    b32 result = (tilemap[i] != Tile_WALL && (type == T_EMPTY || solver_is_pushable(type)));
+    return result;
+}
+
+FUNCTION void solver_distances(u16 *distance, s32 *queue, s32 queue_count)
+{
+    // @Note: Fewest moves from the `queue_count` squares in `queue` (distance 0, the rest U16_MAX)
+    // through anything but solver_player_can_stand(). `queue` needs room for the squares.
+    //
+    for (s32 q = 0; q < queue_count; q++) {
+        s32 i = queue[q];
+        s32 x = i % objmap.pitch;
+        s32 y = i / objmap.pitch;
+        for (s32 a = 0; a < SolverAction_CCW; a++) {
+            s32 nx = x + solver_action_dirs[a].x;
+            s32 ny = y + solver_action_dirs[a].y;
+            if (is_outside_map(nx, ny))
+                continue;
+            
+            s32 n = MAP_IDX(nx, ny);
+            if (distance[n] != U16_MAX || !solver_player_can_stand(n))
+                continue;
+            distance[n]          = distance[i] + 1;
+            queue[queue_count++] = n;
+        }
+    }
+}
+
+FUNCTION void solver_push_costs(u16 *costs, u16 *pushed, u64 *sources, s32 sources_count, u64 *queue)
+{
+    // @Note: Fewest moves to take an obj from each square to one of the sources, which are
+    // (cost << 32 | square), smallest first. A push moves it one square, with the player behind
+    // it; pushing it another way next takes the player at least 2 moves round to the side, or 4
+    // round to the other side. pushed[square*4 + a] is for an obj that was just pushed onto the
+    // square by action a, costs[square*5 + a] for one whose next push is a, and
+    // costs[square*5 + 4] for one that isn't pushed again. Everything else is U16_MAX. `queue`
+    // needs room for 12 entries per square.
+    //
+    s32 squares = solver.level.squares;
+    for (s32 i = 0; i < 4*squares; i++)
+        pushed[i] = U16_MAX;
+    for (s32 i = 0; i < 5*squares; i++)
+        costs[i] = U16_MAX;
+    for (s32 j = 0; j < sources_count; j++) {
+        u32 i = (u32)sources[j];
+        costs[i*5 + 4] = (u16)(sources[j] >> 32);
+        for (s32 a = 0; a < 4; a++)
+            pushed[i*4 + a] = costs[i*5 + 4];
+    }
+    
+    // One queue per step (1, 3 and 5 moves); what goes in each comes out in order, like the
+    // sources, so the smallest of their heads is the next closest.
+    u64 *queues[3] = {queue, queue + 4*squares, queue + 8*squares};
+    s32 heads[3]   = {};
+    s32 tails[3]   = {};
+    for (s32 q = 0;;) {
+        u64 next = U64_MAX;
+        s32 from = -1;
+        if (q < 4*sources_count) {
+            next = (sources[q/4] & 0xFFFFFFFF00000000ULL) | ((u32)sources[q/4]*4 + q%4);
+            from = 3;
+        }
+        for (s32 k = 0; k < 3; k++) {
+            if (heads[k] < tails[k] && queues[k][heads[k]] < next) {
+                next = queues[k][heads[k]];
+                from = k;
+            }
+        }
+        if (from < 0)
+            break;
+        if (from == 3) q++;
+        else           heads[from]++;
+        
+        u32 cost = (u32)(next >> 32);
+        u32 at   = (u32)next;
+        if (pushed[at] < cost)
+            continue;
+        
+        // The square it was pushed from, and where the player stood for that.
+        s32 a = at % 4;
+        V2s d = solver_action_dirs[a];
+        s32 x = (s32)(at/4) % objmap.pitch - d.x;
+        s32 y = (s32)(at/4) / objmap.pitch - d.y;
+        if (is_outside_map(x, y) || is_outside_map(x - d.x, y - d.y))
+            continue;
+        s32 i = MAP_IDX(x, y);
+        if (!solver_obj_can_stand(i) || !solver_player_can_stand(MAP_IDX(x - d.x, y - d.y)))
+            continue;
+        
+        costs[i*5 + a] = (u16)MIN(costs[i*5 + a], cost + 1);
+        for (s32 b = 0; b < 4; b++) {
+            s32 k = (b == a)? 0 : (b == (a + 2) % 4)? 2 : 1;
+            u32 c = cost + 1 + 2*k;
+            if (c < pushed[i*4 + b]) {
+                pushed[i*4 + b]          = (u16)c;
+                queues[k][tails[k]++]    = ((u64)c << 32) | (u64)(i*4 + b);
+            }
+        }
+    }
+}
+
+FUNCTION int solver_compare_u64(const void *a, const void *b)
+{
+    u64 x = *(u64 *)a;
+    u64 y = *(u64 *)b;
+    return (x > y) - (x < y);
+}
+
+FUNCTION void solver_prepare_gates(Solver_Level *level, s32 *queue)
+{
+    // @Note: A gate is a door group with detectors of some color, and it's in the way of a square
+    // if no teleporter can be reached from there with the group's doors closed and every other door
+    // open. Runs after level->distance is filled in. See solver_heuristic().
+    //
+    level->gated = PUSH_ARRAY_ZERO(solver.level_arena, u64, level->squares);
+    u16 *reached = PUSH_ARRAY(solver.level_arena, u16, level->squares);
+    u16 *away    = PUSH_ARRAY(solver.level_arena, u16, level->squares);
+    u64 *sources = PUSH_ARRAY(solver.level_arena, u64, level->squares);
+    u16 *pushed  = PUSH_ARRAY(solver.level_arena, u16, 4*level->squares);
+    u64 *steps   = PUSH_ARRAY(solver.level_arena, u64, 12*level->squares);
+    u8 *lines    = PUSH_ARRAY(solver.level_arena, u8, level->squares);
+    
+    // turns[kind][d]: the dirs an obj of the kind can turn a beam into, facing d.
+    u8 turns[SOLVER_MAX_KINDS][8] = {};
+    for (s32 k = 0; k < level->kinds_count; k++) {
+        for (s32 d = 0; d < level->kinds[k].dirs; d++) {
+            for (s32 src_d = 0; src_d < 8; src_d++) {
+                u8 reflected = beam_optics.e[level->kinds[k].type][d][src_d].reflected;
+                if (reflected != U8_MAX)
+                    turns[k][d] |= (u8)(1 << reflected);
+            }
+        }
+    }
+    
+    s32 first_door = 0;
+    for (s32 g = 0; g < door_index.groups_count; g++) {
+        Door_Group group = door_index.groups[g];
+        if (!group.detectors_count)
+            continue;
+        
+        s32 first = first_door;
+        first_door += group.doors_count;
+        
+        // Unlit detectors are white, so white groups are open until something lights them.
+        if (group.c == Color_WHITE || level->gates_count >= SOLVER_MAX_GATES)
+            continue;
+        
+        // Squares in line with a detector, and the dirs towards it from there, as far as a beam
+        // could come from. A laser pointing down the line might light it from the start.
+        MEMORY_ZERO(lines, level->squares);
+        b32 laser = FALSE;
+        for (s32 i = group.first_detector; i < group.first_detector + group.detectors_count; i++) {
+            V2s detector = door_index.detectors[i];
+            for (u8 d = 0; d < 8; d++) {
+                u8 back = WRAP_D(d + 4);
+                for (s32 x = detector.x + dirs[d].x, y = detector.y + dirs[d].y; !is_outside_map(x, y) && tilemap[MAP_IDX(x, y)] != Tile_WALL; x += dirs[d].x, y += dirs[d].y) {
+                    s32 j   = MAP_IDX(x, y);
+                    u8 type = objmap.type[j];
+                    if (type == T_LASER) {
+                        laser |= (objmap.dir[j] == back);
+                        break;
+                    }
+                    if (type == T_TELEPORTER || (type == T_DOOR && !solver_player_can_stand(j)))
+                        break;
+                    if (solver_obj_can_stand(j))
+                        lines[j] |= (u8)(1 << back);
+                }
+            }
+        }
+        if (laser)
+            continue;
+        
+        Solver_Gate gate = {first, group.doors_count};
+        gate.exit        = U16_MAX;
+        for (s32 i = first; i < first + group.doors_count; i++)
+            gate.exit = MIN(gate.exit, level->distance[level->doors[i]]);
+        
+        // Fewest moves from next to each square into one of the gate's doors.
+        s32 queue_count = 0;
+        for (s32 i = 0; i < level->squares; i++)
+            reached[i] = U16_MAX;
+        for (s32 i = first; i < first + group.doors_count; i++) {
+            reached[level->doors[i]] = 0;
+            queue[queue_count++]     = level->doors[i];
+        }
+        solver_distances(reached, queue, queue_count);
+        for (s32 i = 0; i < level->squares; i++) {
+            away[i] = U16_MAX;
+            s32 x   = i % objmap.pitch;
+            s32 y   = i / objmap.pitch;
+            for (u8 d = 0; d < 8; d++) {
+                if (!is_outside_map(x + dirs[d].x, y + dirs[d].y))
+                    away[i] = MIN(away[i], reached[MAP_IDX(x + dirs[d].x, y + dirs[d].y)]);
+            }
+        }
+        
+        // An obj that isn't in place yet needs the rotations to one that turns a beam down the
+        // line, plus the pushes to get there (each moves or turns it one step), and the player is
+        // next to it after the last one and still has to get to a door.
+        gate.costs = PUSH_ARRAY(solver.level_arena, u16, level->kinds_count*8*level->squares*5);
+        for (s32 k = 0; k < level->kinds_count; k++) {
+            Solver_Kind kind = level->kinds[k];
+            for (s32 d = 0; d < kind.dirs; d++) {
+                s32 sources_count = 0;
+                for (s32 i = 0; i < level->squares; i++) {
+                    if (!lines[i] || away[i] == U16_MAX)
+                        continue;
+                    
+                    for (s32 rotations = 0; rotations <= kind.dirs/2; rotations++) {
+                        if (rotations && is_set(kind.flags, ObjFlags_NEVER_ROTATE))
+                            break;
+                        
+                        u8 facing = turns[k][(d + rotations) % kind.dirs] | turns[k][(d - rotations + kind.dirs) % kind.dirs];
+                        if (lines[i] & facing) {
+                            sources[sources_count++] = ((u64)(rotations + away[i]) << 32) | (u64)i;
+                            break;
+                        }
+                    }
+                }
+                
+                // solver_push_costs() wants the closest sources first.
+                u16 *costs = gate.costs + (k*8 + d)*level->squares*5;
+                qsort(sources, (size_t)sources_count, sizeof(u64), solver_compare_u64);
+                solver_push_costs(costs, pushed, sources, sources_count, steps);
+                
+                for (s32 i = 0; i < level->squares; i++) {
+                    if (lines[i] & turns[k][d])
+                        costs[i*5 + 4] = 0;
+                }
+                for (s32 i = 0; i < level->squares*5; i++) {
+                    if (costs[i] != U16_MAX)
+                        level->max_heuristic = MAX(level->max_heuristic, (u32)(costs[i] + objmap.pitch + objmap.rows + gate.exit));
+                }
+            }
+        }
+        
+        // Squares that only reach a teleporter through the gate's doors.
+        queue_count = 0;
+        for (s32 i = 0; i < level->squares; i++) {
+            reached[i] = U16_MAX;
+            if (objmap.type[i] == T_TELEPORTER) {
+                reached[i]           = 0;
+                queue[queue_count++] = i;
+            }
+        }
+        for (s32 i = group.first_door; i < group.first_door + group.doors_count; i++)
+            reached[MAP_IDX(door_index.doors[i].x, door_index.doors[i].y)] = 0; // Seen, but never queued.
+        solver_distances(reached, queue, queue_count);
+        
+        s32 idx = level->gates_count++;
+        level->gates[idx] = gate;
+        for (s32 i = 0; i < level->squares; i++) {
+            if (reached[i] == U16_MAX && level->distance[i] != U16_MAX)
+                level->gated[i] |= 1ULL << idx;
+        }
+    }
+}
+
+FUNCTION b32 solver_prepare_level(s32 idx)
+{
+    // Runs on thread 0 with the level loaded: works out the state layout and the root node.
+    //
+    Solver_Level *level = &solver.level;
+    for (s32 i = 0; i < solver.threads_count; i++) {
+        Solver_Thread *t = &solver.threads[i];
+        if (level->ring_mask)
+            MEMORY_ZERO(t->buckets, (level->ring_mask + 1)*sizeof(Solver_Chunk *));
+        arena_reset(t->arena);
+        t->free = 0;
+        t->work = 0;
+    }
+    MEMORY_ZERO_STRUCT(level);
+    arena_reset(solver.level_arena);
+    
+    level->idx     = idx;
+    level->squares = objmap.pitch*objmap.rows;
+    level->base    = PUSH_ARRAY(solver.level_arena, u8, 12*level->squares);
+    MEMORY_COPY(level->base, objmap.type, 12*level->squares);
+    
+    for (s32 i = 0; i < level->squares; i++) {
+        u8 type = objmap.type[i];
+        if (solver_is_pushable(type)) {
+            if (solver_find_kind(level, type, objmap.flags[i], objmap.c[i]) < 0) {
+                if (level->kinds_count >= SOLVER_MAX_KINDS)
+                    return FALSE;
+                level->kinds[level->kinds_count++] = {type, objmap.flags[i], objmap.c[i], solver_optics_dirs(type)};
+            }
+            level->pieces_count++;
+            
+            // Pushed objs leave an empty square behind.
+            level->base[i]                      = T_EMPTY;
+            level->base[level->squares*1 + i]   = 0;
+            level->base[level->squares*2 + i]   = 0;
+            level->base[level->squares*3 + i]   = 0;
+        }
+    }
+    if (level->pieces_count > SOLVER_MAX_PIECES || level->squares > U16_MAX)
+        return FALSE;
+    
+    // Only doors with detectors can change; the others stay as they are in base.
+    if (door_index.rebuild)
+        door_index_build(&door_index);
+    for (s32 g = 0; g < door_index.groups_count; g++) {
+        Door_Group group = door_index.groups[g];
+        if (!group.detectors_count)
+            continue;
+        
+        for (s32 i = group.first_door; i < group.first_door + group.doors_count; i++) {
+            if (level->doors_count >= SOLVER_MAX_DOORS)
+                return FALSE;
+            level->doors[level->doors_count++] = (u16)MAP_IDX(door_index.doors[i].x, door_index.doors[i].y);
+        }
+    }
+    
+    // Distances to the teleporters, breadth-first from all of them. Pushable objs and doors that
+    // can open are out of the way sooner or later.
+    //
+    level->distance = PUSH_ARRAY(solver.level_arena, u16, level->squares);
+    s32 *queue      = PUSH_ARRAY(solver.level_arena, s32, level->squares);
+    s32 queue_count = 0;
+    for (s32 i = 0; i < level->squares; i++) {
+        level->distance[i] = U16_MAX;
+        if (objmap.type[i] == T_TELEPORTER) {
+            level->distance[i]    = 0;
+            queue[queue_count++] = i;
+        }
+    }
+    solver_distances(level->distance, queue, queue_count);
+    for (s32 i = 0; i < level->squares; i++) {
+        if (level->distance[i] != U16_MAX)
+            level->max_heuristic = MAX(level->max_heuristic, (u32)level->distance[i]);
+    }
+    solver_prepare_gates(level, queue);
+    level->state_size = 4 + 4*level->pieces_count + ALIGN_UP((level->doors_count + 7)/8, 4);
+    
+    // A child's f is at most its parent's plus the walk and the action (squares + 1), plus its own
+    // heuristic. Anything that wouldn't fit is cut down to what does, which is still a lower bound.
+    level->max_heuristic = MIN(level->max_heuristic, (u32)(SOLVER_MAX_RING - level->squares - 2));
+    level->ring_mask     = 1;
+    while (level->ring_mask < (u32)level->squares + 2 + level->max_heuristic) level->ring_mask *= 2;
+    level->ring_mask--;
+    
+    Random_PCG rng = random_seed((u64)idx);
+    s32 keys_count = level->squares*level->kinds_count*8;
+    level->zobrist_pieces = PUSH_ARRAY(solver.level_arena, u64, keys_count);
+    level->zobrist_player = PUSH_ARRAY(solver.level_arena, u64, level->squares);
+    level->zobrist_doors  = PUSH_ARRAY(solver.level_arena, u64, level->doors_count);
+    for (s32 i = 0; i < keys_count; i++)           level->zobrist_pieces[i] = random_next64(&rng);
+    for (s32 i = 0; i < level->squares; i++)       level->zobrist_player[i] = random_next64(&rng);
+    for (s32 i = 0; i < level->doors_count; i++)   level->zobrist_doors[i]  = random_next64(&rng);
+    
+    // Fresh search.
+    solver_clear(solver.table, (solver.table_mask + 1)*sizeof(u32));
+    solver_clear(solver.configs, (solver.configs_mask + 1)*sizeof(u32));
+    solver.nodes_count = 0;
+    solver.found       = -1;
+    solver.overflow    = FALSE;
+    
+    // A root that can't reach a teleporter leaves the first pass empty.
+    u8 state[SOLVER_MAX_STATE_SIZE];
+    solver_settle();
+    u64 hash     = solver_get_state(level, state);
+    solver.depth = 0;
+    solver_add_child(state, hash, 0, 0, 0);
+    solver_next_pass();
+    
+    return TRUE;
+}
+
+FUNCTION String8 solver_solution(Arena *arena, s32 node)
+{
+    // @Note: Every step is a walk and then the action in its link. The walk is found again the way
+    // solver_expand() found it: from the parent's square to the square the action was taken on.
+    //
+    Solver_Level *level = &solver.level;
+    Solver_Thread *t    = solver_thread;
+    
+    s32 length  = (s32)solver_link_g(solver.links[node]);
+    char *moves = PUSH_ARRAY(arena, char, length + 1);
+    moves[length] = 0;
+    
+    s32 end = length;
+    for (s32 n = node; n; n = (s32)solver_link_parent(solver.links[n])) {
+        u64 link   = solver.links[n];
+        u8 action  = solver_link_action(link);
+        u8 *parent = solver.states + (u64)solver_link_parent(link)*level->state_size;
+        s32 to     = (s32)solver_get_player(solver.states + (u64)n*level->state_size);
+        if (action < SolverAction_CCW) {
+            moves[--end] = solver_action_letters[action];
+            to          -= solver_action_dirs[action].x + solver_action_dirs[action].y*objmap.pitch;
+        } else if (action < SolverAction_TELEPORT) {
+            moves[--end] = solver_action_letters[action];
+        }
+        
+        solver_set_state(level, parent);
+        solver_settle();
+        solver_walk(&t->walk, solver_get_player(parent));
+        ASSERT(t->walk.seen[to] == t->walk.stamp);
+        for (s32 i = to; i != (s32)solver_get_player(parent);) {
+            V2s d        = solver_action_dirs[t->walk.from[i]];
+            moves[--end] = solver_action_letters[t->walk.from[i]];
+            i           -= d.x + d.y*objmap.pitch;
+        }
+    }
+    ASSERT(end == 0);
+    
+    String8 result = string((u8 *)moves, length);
+    return result;
+}
+
+FUNCTION b32 solver_search_level(s32 idx)
+{
+    // Runs on thread 0; the others join in at the barrier.
+    load_level(idx);
+    b32 result = solver_prepare_level(idx);
+    if (result) {
+        pthread_barrier_wait(&solver.barrier);
+        solver_search(0);
+    }
+    return result;
+}
+
+FUNCTION b32 solver_solve_level(s32 idx, Arena *arena, String8 *best, u32 *states)
+{
+    // @Note: Most of the states are objs turned every which way next to the player, so a first
+    // search only rotates objs a beam ends on. That search is cheap, and what it finds is a
+    // solution but not always a shortest one; the full search after it then only has to look at
+    // the states that could still beat it. If the full search runs out of states, `best` is the
+    // shortest solution we know of. Sets solver.found if the full search found a solution,
+    // which is shorter than `best`; if it found none without running out, `best` is a shortest.
+    //
+    s32 max_depth        = solver.max_depth;
+    solver.hit_rotations = TRUE;
+    b32 result           = solver_search_level(idx);
+    solver.hit_rotations = FALSE;
+    
+    *best   = {};
+    *states = MIN(solver.nodes_count, solver.max_nodes);
+    if (result && solver.found >= 0) {
+        *best = solver_solution(arena, solver.found);
+        if (!best->count)
+            return result;
+        solver.max_depth = max_depth? MIN(max_depth, (s32)best->count - 1) : (s32)best->count - 1;
+    }
+    if (result) {
+        result   = solver_search_level(idx);
+        *states += MIN(solver.nodes_count, solver.max_nodes);
+    }
+    solver.max_depth = max_depth;
+    return result;
+}
+
+FUNCTION b32 solver_wants_level(s32 idx, char **names, s32 names_count)
+{
+    if (!names_count)
+        return TRUE;
+    
+    b32 result = FALSE;
+    for (s32 i = 0; i < names_count; i++)
+        result |= (manifest.levels[idx].name == string(names[i]));
+    return result;
+}
+
+FUNCTION String8 solver_unsolved_reason(Arena *arena, b32 prepared, String8 best)
+{
+    String8 result = {};
+    if (!prepared)
+        result = sprint(arena, "too many objs or doors");
+    else if (solver.overflow && best.data)
+        result = sprint(arena, "ran out of states after %u; every solution takes at least %d moves, and the shortest one found takes %d (rerun with a larger -max)", solver.max_nodes, solver.depth, (s32)best.count);
+    else if (solver.overflow)
+        result = sprint(arena, "ran out of states after %u; every solution takes at least %d moves (rerun with a larger -max)", solver.max_nodes, solver.depth);
+    else if (solver.max_depth)
+        result = sprint(arena, "no solution in %d moves or less", solver.max_depth);
+    else
+        result = sprint(arena, "no solution: every state the player can reach was searched");
+    return result;
+}
+
+FUNCTION b32 run_solver(char **names, s32 names_count)
+{
+    printf("{\n  \"threads\": %d,\n  \"max_states\": %lld,\n  \"levels\": [", solver.threads_count, (long long)solver.max_nodes);
+    
+    Array<String8> unsolved;
+    Array<String8> reasons;
+    array_init(&unsolved);
+    array_init(&reasons);
+    
+    b32 first = TRUE;
+    for (s32 idx = 0; idx < manifest.levels_count; idx++) {
+        if (!solver_wants_level(idx, names, names_count) || !solver.package.entries[idx].offset)
+            continue;
+        
+        String8 best  = {};
+        u32 states    = 0;
+        f64 start     = linux_get_seconds();
+        b32 prepared  = solver_solve_level(idx, os->permanent_arena, &best, &states);
+        f64 ms        = (linux_get_seconds() - start)*1000.0;
+        
+        // A full search that found nothing shorter without running out proves `best` is shortest.
+        String8 solution = {};
+        if (prepared && solver.found >= 0)
+            solution = solver_solution(os->permanent_arena, solver.found);
+        else if (prepared && !solver.overflow)
+            solution = best;
+        
+        String8 name = manifest.levels[idx].name;
+        printf("%s\n    {\"name\": \"%.*s\", ", first? "" : ",", (int)name.count, (char *)name.data);
+        if (solution.data) {
+            printf("\"solved\": true, \"moves\": %d, \"solution\": \"%.*s\", \"states\": %u, \"ms\": %.1f}", (s32)solution.count, (int)solution.count, (char *)solution.data, states, ms);
+        } else {
+            String8 reason = solver_unsolved_reason(os->permanent_arena, prepared, best);
+            printf("\"solved\": false, \"reason\": \"%.*s\"", (int)reason.count, (char *)reason.data);
+            if (prepared)
+                printf(", \"exhausted\": %s, \"depth\": %d, \"states\": %u", solver.overflow? "false" : "true", solver.depth, states);
+            if (best.data)
+                printf(", \"best\": {\"moves\": %d, \"solution\": \"%.*s\"}", (s32)best.count, (int)best.count, (char *)best.data);
+            printf(", \"ms\": %.1f}", ms);
+            
+            array_add(&unsolved, name);
+            array_add(&reasons, reason);
+        }
+        fflush(stdout);
+        first = FALSE;
+    }
+    
+    printf("\n  ],\n  \"unsolved\": [");
+    for (s32 i = 0; i < unsolved.count; i++)
+        printf("%s\n    {\"name\": \"%.*s\", \"reason\": \"%.*s\"}", i? "," : "", (int)unsolved[i].count, (char *)unsolved[i].data, (int)reasons[i].count, (char *)reasons[i].data);
+    printf("%s]\n}\n", unsolved.count? "\n  " : "");
+    
+    return !unsolved.count;
+}
+
+FUNCTION b32 run_verifier(char **names, s32 names_count, s32 moves)
+{
+    // @Note: Every thread checks whole levels first. Levels without problems are then searched one
+    // at a time with all the threads, like the solver does.
+    //
+    f64 start = linux_get_seconds();
+    
+    solver.verified = PUSH_ARRAY_ZERO(os->permanent_arena, Verify_Level, manifest.levels_count);
+    for (s32 idx = VERIFY_FIRST_LEVEL; idx < manifest.levels_count; idx++)
+        solver.verified[idx].wanted = manifest.levels[idx].name.count && solver_wants_level(idx, names, names_count);
+    
+    solver.verifying     = TRUE;
+    solver.verify_cursor = 0;
+    pthread_barrier_wait(&solver.barrier);
+    verify_levels();
+    pthread_barrier_wait(&solver.barrier);
+    solver.verifying     = FALSE;
+    
+    // The search runs on the package, so make sure it's built from the files we just checked.
+    build_level_package(&game->package, game->package_arena);
+    solver.package = game->package;
+    solver.max_depth = moves;
+    
+    printf("{\n  \"threads\": %d,\n  \"moves\": %d,\n  \"levels\": [", solver.threads_count, moves);
+    
+    b32 all_ok = TRUE;
+    b32 first  = TRUE;
+    for (s32 idx = 0; idx < manifest.levels_count; idx++) {
+        Verify_Level *v = &solver.verified[idx];
+        if (!v->checked)
+            continue;
+        
+        String8 name = manifest.levels[idx].name;
+        printf("%s\n    {\"name\": \"%.*s\", \"squares\": %d, \"lasers\": %d, \"detectors\": %d, \"doors\": %d",
+               first? "" : ",", (int)name.count, (char *)name.data, v->squares, v->lasers, v->detectors, v->doors);
+        
+        if (moves && !v->problems.count) {
+            String8 best = {};
+            u32 states   = 0;
+            b32 prepared = solver_solve_level(idx, os->permanent_arena, &best, &states);
+            if (prepared && solver.found >= 0)
+                best = solver_solution(os->permanent_arena, solver.found);
+            
+            if (!prepared) {
+                printf(", \"solved\": false, \"exhausted\": false");
+            } else if (best.data) {
+                printf(", \"solved\": true, \"moves\": %d, \"solution\": \"%.*s\"", (s32)best.count, (int)best.count, (char *)best.data);
+            } else {
+                // Running out of states proves nothing, so it's not a problem.
+                printf(", \"solved\": false, \"exhausted\": %s", solver.overflow? "false" : "true");
+                if (!solver.overflow)
+                    array_add(&v->problems, sprint(v->arena, "no solution in %d moves or less", moves));
+            }
+        }
+        
+        printf(", \"problems\": [");
+        for (s32 i = 0; i < v->problems.count; i++)
+            printf("%s\"%.*s\"", i? ", " : "", (int)v->problems[i].count, (char *)v->problems[i].data);
+        printf("]}");
+        fflush(stdout);
+        
+        all_ok &= !v->problems.count;
+        first   = FALSE;
+    }
+    printf("\n  ],\n  \"ms\": %.1f\n}\n", (linux_get_seconds() - start)*1000.0);
+    
+    // Don't exit before the rebuilt package is on disk.
+    posix_wait_for_file_writes();
+    
+    return all_ok;
+}
+
+FUNCTION void print_usage(FILE *file)
+{
+    fprintf(file,
+            "Usage: nur_solver [-threads n] [-max states] [level_name ...]\n"
+            "       nur_solver -verify [-moves n] [-threads n] [-max states] [level_name ...]\n"
+            "\n"
+            "Finds the shortest solution of every level in the package, or of the named ones, and prints\n"
+            "them as JSON. Exits with 1 if any level is left unsolved; the report says why.\n"
+            "\n"
+            "  -threads n   Search threads (default: one per CPU).\n"
+            "  -max states  States to keep per level before giving up (default: %lld).\n"
+            "  -verify      Check the .nlf files instead; with -moves, also look for a solution of at most n moves.\n"
+            "  -h, --help   Print this and exit.\n",
+            (long long)SOLVER_DEFAULT_MAX_NODES);
+}
+
+int main(int argc, char **argv)
+{
+    s32 threads_count = (s32)sysconf(_SC_NPROCESSORS_ONLN);
+    s64 max_nodes     = SOLVER_DEFAULT_MAX_NODES;
+    b32 verify        = FALSE;
+    s32 moves         = 0;
+    char **names      = argv + argc;
+    s32 names_count   = 0;
+    for (s32 i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "-threads") == 0) && (i+1 < argc)) {
+            threads_count = atoi(argv[++i]);
+        } else if ((strcmp(argv[i], "-max") == 0) && (i+1 < argc)) {
+            max_nodes = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "-verify") == 0) {
+            verify = TRUE;
+        } else if ((strcmp(argv[i], "-moves") == 0) && (i+1 < argc)) {
+            moves = atoi(argv[++i]);
+        } else if ((strcmp(argv[i], "-h") == 0) || (strcmp(argv[i], "-help") == 0) || (strcmp(argv[i], "--help") == 0)) {
+            print_usage(stdout);
+            return 0;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Unknown or incomplete option '%s'.\n\n", argv[i]);
+            print_usage(stderr);
+            return 1;
+        } else {
+            names       = argv + i;
+            names_count = argc - i;
+            break;
+        }
+    }
+    threads_count = CLAMP(1, threads_count, 256);
+    max_nodes     = CLAMP(1024, max_nodes, (s64)U32_MAX/2);
+    moves         = CLAMP_LOWER(moves, 0);
+    
+    linux_os_init(0);
+    
+    // @Note: Only the part of game_init() that loads levels.
+    game                     = PUSH_STRUCT_ZERO(os->permanent_arena, Game_State);
+    game->loaded_level_arena = arena_init(MEGABYTES(1));
+    game->package_arena      = arena_init(MEGABYTES(16));
+    load_level_manifest(&manifest);
+    if (!load_level_package(&game->package))
+        build_level_package(&game->package, game->package_arena);
+    undo_handler_init(&undo_handler);
+    
+    solver.threads_count = threads_count;
+    solver.max_nodes     = (u32)max_nodes;
+    solver.manifest      = manifest;
+    solver.package       = game->package;
+    solver.level_arena   = arena_init((u64)LEVEL_MAX_SQUARES*(12 + 1 + 15*sizeof(u64) + SOLVER_MAX_KINDS*8*sizeof(u64) + 7*sizeof(u16) + sizeof(s32)) +
+                                      (u64)SOLVER_MAX_GATES*SOLVER_MAX_KINDS*8*LEVEL_MAX_SQUARES*5*sizeof(u16) + SOLVER_MAX_DOORS*sizeof(u64) + KILOBYTES(4));
+    solver.states        = (u8  *)solver_reserve((u64)max_nodes*SOLVER_MAX_STATE_SIZE);
+    solver.hashes        = (u64 *)solver_reserve((u64)max_nodes*sizeof(u64));
+    solver.links         = (u64 *)solver_reserve((u64)max_nodes*sizeof(u64));
+    
+    // Table at most half full.
+    u64 table_size = 1;
+    while (table_size < 2*(u64)max_nodes) table_size *= 2;
+    solver.table      = (u32 *)solver_reserve(table_size*sizeof(u32));
+    solver.table_mask = table_size - 1;
+    
+    solver.configs      = (u32 *)solver_reserve(table_size*sizeof(u32));
+    solver.configs_mask = table_size - 1;
+    
+    solver.threads = PUSH_ARRAY_ZERO(os->permanent_arena, Solver_Thread, threads_count);
+    for (s32 i = 0; i < threads_count; i++) {
+        Solver_Thread *t = &solver.threads[i];
+        t->arena         = arena_init();
+        t->buckets       = (Solver_Chunk **)solver_reserve(SOLVER_MAX_RING*sizeof(Solver_Chunk *));
+        for (Solver_Walk *walk = &t->walk; walk <= &t->child_walk; walk++) {
+            walk->queue    = PUSH_ARRAY(os->permanent_arena, u16, LEVEL_MAX_SQUARES);
+            walk->distance = PUSH_ARRAY(os->permanent_arena, u16, LEVEL_MAX_SQUARES);
+            walk->from     = PUSH_ARRAY(os->permanent_arena, u8,  LEVEL_MAX_SQUARES);
+            walk->seen     = PUSH_ARRAY_ZERO(os->permanent_arena, u32, LEVEL_MAX_SQUARES);
+            walk->red      = PUSH_ARRAY_ZERO(os->permanent_arena, u32, LEVEL_MAX_SQUARES);
+            walk->hit      = PUSH_ARRAY_ZERO(os->permanent_arena, u32, LEVEL_MAX_SQUARES);
+        }
+    }
+    solver_thread_init(0);
+    
+    pthread_barrier_init(&solver.barrier, 0, (u32)threads_count);
+    pthread_t *threads = PUSH_ARRAY(os->permanent_arena, pthread_t, threads_count);
+    for (s32 i = 1; i < threads_count; i++)
+        pthread_create(&threads[i], 0, solver_worker, (void *)(s64)i);
+    
+    b32 ok = verify? run_verifier(names, names_count, moves) : run_solver(names, names_count);
+    
+    solver.quit = TRUE;
+    pthread_barrier_wait(&solver.barrier);
+    for (s32 i = 1; i < threads_count; i++)
+        pthread_join(threads[i], 0);
+    
+    return ok? 0 : 1;
+}
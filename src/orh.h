@@ -1,4 +1,4 @@
-/* orh.h - v0.69 - C++ utility library. Includes types, math, string, memory arena, and other stuff.
+/* orh.h - v0.72 - C++ utility library. Includes types, math, string, memory arena, and other stuff.
 
 In _one_ C++ file, #define ORH_IMPLEMENTATION before including this header to create the
  implementation. 
@@ -9,6 +9,9 @@ Like this:
 #include "orh.h"
 
 REVISION HISTORY:
+0.72 - fixed array_resize() not compiling outside MSVC.
+0.71 - added map_file() and unmap_file() in OS_State.
+0.70 - added write_entire_file_async() and wait_for_file_writes() in OS_State.
 0.69 - added array_resize() for if we want to allocate memory upfront and fill data using indexing.
 0.68 - added TRUE and FALSE macros.
 0.67 - added clear_key_states() and clear_key_states_all().
@@ -1298,7 +1301,7 @@ void array_resize(Array<T> *array, s64 size)
 {
     // @Note: Use this function to reserve size upfront and fill items using array[index];
     array_reserve(array, size);
-    count = size;
+    array->count = size;
 }
 
 template<typename T>
@@ -1802,7 +1805,11 @@ struct OS_State
     void    (*print_to_console)(String8 text);
     void    (*free_file_memory)(void *memory);  // @Redundant: Does same thing as release().
     String8 (*read_entire_file)(String8 full_path);
+    String8 (*map_file)(String8 full_path); // Read-only view of the file; valid until unmap_file().
+    void    (*unmap_file)(String8 file);
     b32     (*write_entire_file)(String8 full_path, String8 data);
+    void    (*write_entire_file_async)(String8 full_path, String8 data); // Copies data and returns; written in the background.
+    void    (*wait_for_file_writes)();
     Sound   (*sound_load)(String8 full_path, u32 sample_rate);
 };
 extern OS_State *os;
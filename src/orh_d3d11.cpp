@@ -187,9 +187,14 @@ FUNCTION void d3d11_load_texture(Texture *texture, s32 w, s32 h, u8 *color_data)
 FUNCTION void d3d11_load_texture(Texture *texture, String8 full_path)
 {
 	texture->full_path = full_path;
-    u8 *color_data = stbi_load((const char*)full_path.data, 
-                               &texture->width, &texture->height, 
-                               &texture->bpp, 4);
+    String8 file   = os->map_file(full_path);
+    u8 *color_data = 0;
+    if (file.data) {
+        color_data = stbi_load_from_memory(file.data, (s32)file.count, 
+                                           &texture->width, &texture->height, 
+                                           &texture->bpp, 4);
+        os->unmap_file(file);
+    }
     if (color_data) {
         //
         // Create texture as shader resource and create view.
@@ -225,9 +230,9 @@ FUNCTION void d3d11_load_font(Font *font, String8 full_path, s32 ascii_start, s3
     defer(free_scratch(scratch));
     
     font->full_path = full_path;
-    String8 file    = os->read_entire_file(full_path);
+    String8 file    = os->map_file(full_path);
     ASSERT(file.data);
-    defer(os->free_file_memory(file.data));
+    defer(os->unmap_file(file));
     
     stbtt_InitFont(&font->info, file.data, 0);
     
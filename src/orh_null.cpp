@@ -0,0 +1,212 @@
+/* orh_null.cpp - v0.01 - Null renderer with the same interface as orh_d3d11.cpp.
+
+#include "orh.h" before this file.
+
+Used by headless platform layers (no window, no GPU). Textures only read their dimensions, draw calls
+do nothing, and the camera transforms are computed the same way as in orh_d3d11.cpp so anything the
+game derives from them stays correct.
+
+*/
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb/stb_image.h"
+
+// @Note: Opaque stand-ins so the game's renderer globals still compile. Never dereferenced.
+struct ID3D11ShaderResourceView;
+struct ID3D11InputLayout;
+struct ID3D11Buffer;
+struct ID3D11VertexShader;
+struct ID3D11PixelShader;
+
+////////////////////////////////
+// Transforms.
+//
+GLOBAL M4x4         object_to_world_matrix = m4x4_identity();
+GLOBAL M4x4_Inverse world_to_view_matrix   = {m4x4_identity(), m4x4_identity()};
+GLOBAL M4x4_Inverse view_to_proj_matrix    = {m4x4_identity(), m4x4_identity()};
+
+// Textures.
+//
+struct Texture
+{
+    String8 full_path;
+    
+    s32 width, height;
+    s32 bpp;
+    
+    ID3D11ShaderResourceView *view;
+};
+GLOBAL Texture white_texture;
+
+//
+// Fonts.
+//
+struct Font
+{
+    String8 full_path;
+    Texture atlas;
+};
+GLOBAL Font consolas;
+
+////////////////////////////////
+// Immediate mode renderer info.
+//
+struct Immediate_PS_Constants
+{
+    V2  drawing_rect_size;
+    V2  line_p0;
+    V2  line_p1;
+    b32 is_line;
+};
+GLOBAL Immediate_PS_Constants immediate_ps_constants;
+
+// State.
+//
+GLOBAL b32 is_using_pixel_coords;
+
+////////////////////////////////
+////////////////////////////////
+
+FUNCTION void d3d11_load_texture(Texture *texture, String8 full_path)
+{
+    texture->full_path = full_path;
+    String8 file = os->map_file(full_path);
+    if (file.data) {
+        if (!stbi_info_from_memory(file.data, (s32)file.count, &texture->width, &texture->height, &texture->bpp))
+            print("STBI ERROR: failed to load image %S\n", texture->full_path);
+        os->unmap_file(file);
+    }
+}
+
+FUNCTION f32 get_text_width(Font *font, s32 vh, char *format, va_list arg_list)
+{
+    return 0.0f;
+}
+
+FUNCTION f32 get_text_width(Font *font, s32 vh, char *format, ...)
+{
+    return 0.0f;
+}
+
+FUNCTION f32 get_text_height(Font *font, s32 vh, char *format, va_list arg_list)
+{
+    return 0.0f;
+}
+
+FUNCTION f32 get_text_height(Font *font, s32 vh, char *format, ...)
+{
+    return 0.0f;
+}
+
+////////////////////////////////
+// Immediate mode renderer functions.
+//
+FUNCTION void set_texture(Texture *texture)
+{
+}
+
+FUNCTION void set_view_to_proj()
+{
+    f32 ar = (f32)os->render_size.w / (f32)os->render_size.h;
+    view_to_proj_matrix = perspective(120.0f * DEGS_TO_RADS, ar, 0.01f, 10.0f);
+}
+
+FUNCTION void set_world_to_view(V3 camera_position)
+{
+    world_to_view_matrix = look_at(camera_position,
+                                   camera_position + v3(0, 0, -1),
+                                   v3(0, 1, 0));
+}
+
+FUNCTION void set_object_to_world(V3 position, Quaternion orientation)
+{
+    M4x4 m = m4x4_identity();
+    m._14  = position.x;
+    m._24  = position.y;
+    m._34  = position.z;
+    
+    M4x4 r = m4x4_from_quaternion(orientation);
+    
+    object_to_world_matrix = m * r;
+}
+
+FUNCTION V2 pixel_to_ndc(V2 pixel)
+{
+    // @Note: pixel relative to drawing_rect.
+    //
+    f32 w = get_width(os->drawing_rect);
+    f32 h = get_height(os->drawing_rect);
+    
+    V2 p = hadamard_div(pixel, v2(w, h));
+    p    = p*2 - v2(1);
+    p.y *= -1;
+    
+    return p;
+}
+
+FUNCTION V2 world_to_ndc(V2 point)
+{
+    // Clip space is same as proj space.
+    M4x4 world_to_proj = view_to_proj_matrix.forward * world_to_view_matrix.forward;
+    V4 point_clip      = world_to_proj * v4(point.x, point.y, 0, 1);
+    
+    V2 result;
+    result.x = point_clip.x / point_clip.w;
+    result.y = point_clip.y / point_clip.w;
+    
+    return result;
+}
+
+FUNCTION void immediate_end()
+{
+    is_using_pixel_coords          = FALSE;
+    immediate_ps_constants.is_line = FALSE;
+}
+
+FUNCTION void immediate_begin(b32 wireframe = FALSE)
+{
+}
+
+FUNCTION void immediate_triangle(V2 p0, V2 p1, V2 p2, V4 color)
+{
+}
+
+FUNCTION void immediate_quad(V2 p0, V2 p1, V2 p2, V2 p3, V4 color)
+{
+}
+
+FUNCTION void immediate_rect(V2 center, V2 half_size, V4 color)
+{
+}
+
+FUNCTION void immediate_rect(V2 center, V2 half_size, V2 uv_min, V2 uv_max, V4 color)
+{
+}
+
+FUNCTION void immediate_rect(V2 center, V2 half_size, V2 uv0, V2 uv1, V2 uv2, V2 uv3, V4 color)
+{
+}
+
+FUNCTION void immediate_rect_tl(V2 top_left, V2 size, V4 color)
+{
+}
+
+FUNCTION void immediate_rect_tl(V2 top_left, V2 size, V2 uv_min, V2 uv_max, V4 color)
+{
+}
+
+FUNCTION void immediate_text(Font *font, V2 baseline, s32 vh, V4 color, char *format, va_list arg_list)
+{
+}
+
+FUNCTION void immediate_text(Font *font, V2 baseline, s32 vh, V4 color, char *format, ...)
+{
+}
+
+FUNCTION void immediate_line_2d(V2 p0, V2 p1, V4 color, f32 thickness = 0.1f)
+{
+}
+
+FUNCTION void immediate_grid(V2 bottom_left, u32 grid_width, u32 grid_height, f32 cell_size, V4 color, f32 line_thickness = 0.025f)
+{
+}
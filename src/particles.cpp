@@ -1,6 +1,7 @@
 
 FUNCTION void create_particle_shader()
 {
+#if !HEADLESS
     // Shader input layout.
     D3D11_INPUT_ELEMENT_DESC layout_desc[] = 
     {
@@ -50,6 +51,7 @@ FUNCTION void create_particle_shader()
     String8 hlsl =
 #include "particle.hlsl"
     d3d11_compile_shader(hlsl, layout_desc, ARRAYSIZE(layout_desc), &particle_input_layout, &particle_vs, &particle_ps);
+#endif
 }
 
 FUNCTION void obj_emitter_init(s32 amount)
@@ -167,6 +169,7 @@ FUNCTION void obj_emitter_update_particles()
 
 FUNCTION void obj_emitter_draw_particles()
 {
+#if !HEADLESS
     Particle_Emitter *e = &game->obj_emitter;
     
     // Bind Input Assembler.
@@ -221,4 +224,5 @@ FUNCTION void obj_emitter_draw_particles()
             device_context->Draw(6, 0);
         }
     }
+#endif
 }
@@ -0,0 +1,157 @@
+#ifndef POSIX_FILE_H
+#define POSIX_FILE_H
+
+// @Note: POSIX versions of the OS_State file functions, for platform layers other than Win32.
+// Include after orh.h.
+//
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+FUNCTION void posix_free_file_memory(void *memory)
+{
+    free(memory);
+}
+
+FUNCTION String8 posix_read_entire_file(String8 full_path)
+{
+    String8 result = {};
+    
+    s32 fd = open((char*)full_path.data, O_RDONLY);
+    if (fd < 0) {
+        print("OS Error: read_entire_file() open() failed!\n");
+        return result;
+    }
+    
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        print("OS Error: read_entire_file() fstat() failed!\n");
+        close(fd);
+        return result;
+    }
+    
+    u64 file_size = (u64)file_stat.st_size;
+    result.data   = (u8 *) malloc(file_size? file_size : 1);
+    if (!result.data) {
+        print("OS Error: read_entire_file() malloc() returned 0!\n");
+        close(fd);
+        return result;
+    }
+    
+    u64 bytes_read = 0;
+    while (bytes_read < file_size) {
+        s64 n = read(fd, result.data + bytes_read, file_size - bytes_read);
+        if (n <= 0) break;
+        bytes_read += (u64)n;
+    }
+    
+    if (bytes_read == file_size) {
+        result.count = file_size;
+    } else {
+        print("OS Error: read_entire_file() read() failed!\n");
+        
+        posix_free_file_memory(result.data);
+        result.data = 0;
+    }
+    
+    close(fd);
+    
+    return result;
+}
+
+FUNCTION String8 posix_map_file(String8 full_path)
+{
+    // @Note: Closing the descriptor is fine; the mapping stays valid until posix_unmap_file().
+    //
+    String8 result = {};
+    
+    s32 fd = open((char*)full_path.data, O_RDONLY);
+    if (fd < 0) {
+        print("OS Error: map_file() open() failed!\n");
+        return result;
+    }
+    
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+        void *memory = mmap(0, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (memory != MAP_FAILED) {
+            result.data  = (u8 *) memory;
+            result.count = (u64)file_stat.st_size;
+        } else {
+            print("OS Error: map_file() mmap() failed!\n");
+        }
+    } else {
+        print("OS Error: map_file() file is empty or fstat() failed!\n");
+    }
+    
+    close(fd);
+    
+    return result;
+}
+
+FUNCTION void posix_unmap_file(String8 file)
+{
+    if (file.data) {
+        munmap(file.data, file.count);
+    }
+}
+
+FUNCTION b32 posix_write_entire_file(String8 full_path, String8 data)
+{
+    // @Note: Same scheme as the Win32 layer: write a temporary file, fsync() it, then rename() it over
+    // the destination, so a crash leaves either the old file or the new one.
+    //
+    b32 result = FALSE;
+    
+    char temp_path[4096];
+    string_format(temp_path, sizeof(temp_path), "%S.tmp", full_path);
+    
+    s32 fd = open(temp_path, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if (fd < 0) {
+        print("OS Error: write_entire_file() open() failed!\n");
+        return result;
+    }
+    
+    u64 bytes_written = 0;
+    while (bytes_written < data.count) {
+        s64 n = write(fd, data.data + bytes_written, data.count - bytes_written);
+        if (n <= 0) break;
+        bytes_written += (u64)n;
+    }
+    
+    if ((bytes_written == data.count) && (fsync(fd) == 0)) {
+        result = TRUE;
+    } else {
+        print("OS Error: write_entire_file() write() failed!\n");
+    }
+    
+    close(fd);
+    
+    if (result) {
+        result = (rename(temp_path, (char*)full_path.data) == 0);
+        if (!result)
+            print("OS Error: write_entire_file() rename() failed!\n");
+    }
+    if (!result)
+        unlink(temp_path);
+    
+    return result;
+}
+
+// @Note: No writer thread here; headless layers don't have a frame to protect, so async writes just
+// happen in place and there's never anything to wait for.
+//
+FUNCTION void posix_write_entire_file_async(String8 full_path, String8 data)
+{
+    posix_write_entire_file(full_path, data);
+}
+
+FUNCTION void posix_wait_for_file_writes()
+{
+}
+
+#endif //POSIX_FILE_H
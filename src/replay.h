@@ -0,0 +1,216 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+// @Note: Recording and playback; the file format and Replay live in game.h.
+//
+FUNCTION void replay_pack_bits(u8 *bits, b32 *values, s32 count)
+{
+    for (s32 i = 0; i < count; i++) {
+        u8 bit = (u8)(1 << (i%8));
+        bits[i/8] = values[i]? (u8)(bits[i/8] | bit) : (u8)(bits[i/8] & ~bit);
+    }
+}
+
+FUNCTION void replay_unpack_bits(b32 *values, u8 *bits, s32 count)
+{
+    for (s32 i = 0; i < count; i++)
+        values[i] = (bits[i/8] >> (i%8)) & 1;
+}
+
+FUNCTION u64 replay_state_hash()
+{
+    // @Note: Obj planes, the player and the undo depth; everything a move can change.
+    //
+    struct
+    {
+        s32 px, py;
+        u8  pdir, pcolor;
+        b32 dead;
+        s32 level_idx;
+        s32 undo_count;
+    } player;
+    
+    // Zeroed first so the padding hashes the same every time.
+    MEMORY_ZERO_STRUCT(&player);
+    player.px         = px;
+    player.py         = py;
+    player.pdir       = pdir;
+    player.pcolor     = pcolor;
+    player.dead       = dead;
+    player.level_idx  = current_level_idx;
+    player.undo_count = undo_depth(&undo_handler);
+    
+    s32 n = objmap.pitch*objmap.rows;
+    u64 result = ((u64)get_hash(string(objmap.type, 12*n)) << 32) | get_hash(string((u8 *)&player, sizeof(player)));
+    return result;
+}
+
+FUNCTION void replay_restore_start(Replay_Header *header)
+{
+    // Both recording and playback start from here, so anything update_world() carries between ticks
+    // must be reset.
+    //
+    load_level(header->level_idx);
+    latest_level_idx       = header->latest_level_idx;
+    prompt_user_on_restart = header->prompt_user_on_restart;
+    game->rng              = header->rng;
+    os->time               = header->time;
+    
+    game_started     = TRUE;
+    current_mode     = M_GAME;
+    game->thank_you  = FALSE;
+    animation_timer  = 0;
+    move_hold_timer  = 0;
+    last_pressed     = 0;
+    undo_hold_timer  = 0;
+    undo_speed_scale = 1.0f;
+}
+
+FUNCTION void replay_begin_recording()
+{
+    if (!replay.ticks.arena)
+        array_init(&replay.ticks);
+    array_reset(&replay.ticks);
+    
+    Replay_Header *h = &replay.header;
+    MEMORY_ZERO_STRUCT(h);
+    h->magic                  = REPLAY_MAGIC;
+    h->version                = REPLAY_VERSION;
+    h->manifest_hash          = manifest.hash;
+    h->level_idx              = current_level_idx;
+    h->latest_level_idx       = latest_level_idx;
+    h->prompt_user_on_restart = prompt_user_on_restart;
+    h->dt                     = os->dt;
+    h->time                   = os->time;
+    h->rng                    = game->rng;
+    
+    replay_restore_start(h);
+    replay.mode = ReplayMode_RECORDING;
+    print("Replay: recording from level %S\n", manifest.levels[h->level_idx].name);
+}
+
+FUNCTION void replay_end_recording(String8 full_path)
+{
+    replay.mode = ReplayMode_NONE;
+    replay.header.ticks_count = (s32)replay.ticks.count;
+    
+    String_Builder sb = begin_save_buffer();
+    sb_append(&sb, &replay.header);
+    sb_append(&sb, replay.ticks.data, replay.ticks.count*sizeof(Replay_Tick));
+    os->write_entire_file_async(full_path, string(sb.start, sb.length));
+    
+    print("Replay: saved %d ticks to %S\n", replay.header.ticks_count, full_path);
+}
+
+FUNCTION b32 replay_load(String8 full_path)
+{
+    String8 file = os->map_file(full_path);
+    if (!file.data) {
+        print("Replay: couldn't open %S\n", full_path);
+        return FALSE;
+    }
+    defer(os->unmap_file(file));
+    
+    Replay_Header h = {};
+    if (file.count >= sizeof(h))
+        MEMORY_COPY(&h, file.data, sizeof(h));
+    
+    u64 ticks_size = (u64)h.ticks_count*sizeof(Replay_Tick);
+    if (h.magic != REPLAY_MAGIC || h.version != REPLAY_VERSION || h.ticks_count < 0 ||
+        file.count != sizeof(h) + ticks_size) {
+        print("Replay: %S is not a valid replay\n", full_path);
+        return FALSE;
+    }
+    if (h.manifest_hash != manifest.hash)
+        print("Replay: level manifest changed since %S was recorded\n", full_path);
+    if (h.level_idx < 0 || h.level_idx >= manifest.levels_count) {
+        print("Replay: %S starts on an unknown level\n", full_path);
+        return FALSE;
+    }
+    
+    if (!replay.ticks.arena)
+        array_init(&replay.ticks);
+    array_resize(&replay.ticks, h.ticks_count);
+    MEMORY_COPY(replay.ticks.data, file.data + sizeof(h), ticks_size);
+    replay.header = h;
+    
+    return TRUE;
+}
+
+FUNCTION void replay_begin_playback()
+{
+    os->dt = replay.header.dt;
+    replay_restore_start(&replay.header);
+    
+    replay.cursor        = 0;
+    replay.mismatch_tick = -1;
+    replay.mode          = replay.ticks.count? ReplayMode_PLAYING : ReplayMode_NONE;
+}
+
+FUNCTION void replay_begin_tick()
+{
+    // @Note: Called at the top of game_update(), after the OS layer filled in this tick's input.
+    //
+    if (replay.mode == ReplayMode_RECORDING) {
+        Replay_Tick t = {};
+        replay_pack_bits(t.pressed,  os->pressed,  Key_COUNT);
+        replay_pack_bits(t.held,     os->held,     Key_COUNT);
+        replay_pack_bits(t.released, os->released, Key_COUNT);
+        
+        Gamepad *g = &os->gamepads[0];
+        t.gamepad_connected = g->connected;
+        replay_pack_bits((u8 *)&t.gamepad_pressed,  g->pressed,  GamepadButton_COUNT);
+        replay_pack_bits((u8 *)&t.gamepad_held,     g->held,     GamepadButton_COUNT);
+        replay_pack_bits((u8 *)&t.gamepad_released, g->released, GamepadButton_COUNT);
+        
+        t.level_idx = current_level_idx;
+        array_add(&replay.ticks, t);
+    } else if (replay.mode == ReplayMode_PLAYING) {
+        MEMORY_COPY(replay.saved_pressed,  os->pressed,  sizeof(os->pressed));
+        MEMORY_COPY(replay.saved_held,     os->held,     sizeof(os->held));
+        MEMORY_COPY(replay.saved_released, os->released, sizeof(os->released));
+        replay.saved_gamepad = os->gamepads[0];
+        
+        Replay_Tick *t = &replay.ticks[replay.cursor];
+        replay_unpack_bits(os->pressed,  t->pressed,  Key_COUNT);
+        replay_unpack_bits(os->held,     t->held,     Key_COUNT);
+        replay_unpack_bits(os->released, t->released, Key_COUNT);
+        
+        Gamepad *g   = &os->gamepads[0];
+        g->connected = t->gamepad_connected;
+        replay_unpack_bits(g->pressed,  (u8 *)&t->gamepad_pressed,  GamepadButton_COUNT);
+        replay_unpack_bits(g->held,     (u8 *)&t->gamepad_held,     GamepadButton_COUNT);
+        replay_unpack_bits(g->released, (u8 *)&t->gamepad_released, GamepadButton_COUNT);
+        
+        if (t->level_idx != current_level_idx && replay.mismatch_tick < 0) {
+            replay.mismatch_tick = replay.cursor;
+            print("Replay: tick %d expected level %d, on level %d\n", replay.cursor, t->level_idx, current_level_idx);
+        }
+    }
+}
+
+FUNCTION void replay_end_tick()
+{
+    if (replay.mode == ReplayMode_RECORDING) {
+        replay.ticks[replay.ticks.count-1].state_hash = replay_state_hash();
+    } else if (replay.mode == ReplayMode_PLAYING) {
+        Replay_Tick *t = &replay.ticks[replay.cursor];
+        if (replay_state_hash() != t->state_hash && replay.mismatch_tick < 0) {
+            replay.mismatch_tick = replay.cursor;
+            print("Replay: state diverged at tick %d\n", replay.cursor);
+        }
+        
+        MEMORY_COPY(os->pressed,  replay.saved_pressed,  sizeof(os->pressed));
+        MEMORY_COPY(os->held,     replay.saved_held,     sizeof(os->held));
+        MEMORY_COPY(os->released, replay.saved_released, sizeof(os->released));
+        os->gamepads[0] = replay.saved_gamepad;
+        
+        replay.cursor++;
+        if (replay.cursor >= replay.ticks.count) {
+            replay.mode = ReplayMode_NONE;
+            print("Replay: played %d ticks, %s\n", replay.cursor, replay.mismatch_tick < 0? "no divergence" : "DIVERGED");
+        }
+    }
+}
+
+#endif //REPLAY_H
@@ -0,0 +1,22 @@
+#!/bin/sh
+
+# Regression checks on the headless build; run build_linux.sh first. Exits with 1 if any of them fails.
+#
+# tests/replays: every recording must play back without its per-tick state hashes (obj planes, player,
+#                undo depth; see replay_state_hash()) diverging. A change that's meant to alter the
+#                simulation or a level has to re-record them, e.g.
+#                    ./nur_headless -record ../tests/replays/intro.rec intro 1800 1
+# -undo-check:   undo_jump() must land on the same state as walking the history step by step.
+#
+cd "$(dirname "$0")"
+cd ../build || exit 1
+
+status=0
+
+for rec in ../tests/replays/*.rec; do
+    ./nur_headless -replay "$rec" || status=1
+done
+
+./nur_headless -undo-check 20000 || status=1
+
+exit $status
@@ -10,27 +10,31 @@ enum Action_Type
     ActionType_OBJ_ROTATE,
 };
 
+// @Note: Actions hold both sides of the change so they can be undone and redone. Coordinates fit in
+// s16 (levels are nowhere near that big), which keeps an action at 12 bytes.
+//
 struct Player_Move
 {
-    s32 x, y;
-    u8 dir;
+    s16 from_x, from_y;
+    s16 to_x, to_y;
+    u8  from_dir, to_dir;
 };
 
 struct Obj_Move
 {
-    s32 from_x, from_y;
-    s32 to_x, to_y;
+    s16 from_x, from_y;
+    s16 to_x, to_y;
 };
 
 struct Obj_Rotate
 {
-    s32 x, y;
-    u8 dir;
+    s16 x, y;
+    u8  from_dir, to_dir;
 };
 
 struct Undo_Action
 {
-    Action_Type type;
+    u8 type; // Action_Type.
     
     union
     {
@@ -40,36 +44,174 @@ struct Undo_Action
     };
 };
 
-struct Undo_Record
+#define MAX_ACTIONS_PER_RECORD 8
+
+// @Note: The log is the ring log: one ring of actions, and one holding how many actions each record
+// used, oldest first. A record is its count plus that many consecutive actions. Records
+// [first_record, step) are applied and [step, end_record) can be redone until a new record is
+// pushed. Positions only ever grow and are masked on access.
+//
+// A ring that fills up doubles in place instead of dropping anything, so history is unlimited up to
+// MAX_RECORDS and MAX_UNDO_ACTIONS. Only past those is the oldest record dropped.
+//
+// Sizes must be powers of two.
+#define MAX_RECORDS       (1 << 20)
+#define MAX_UNDO_ACTIONS  (1 << 21)
+#define UNDO_RING_MIN     1024
+
+// @Note: Snapshot of everything actions touch, taken every UNDO_CHECKPOINT_INTERVAL records, so
+// jumping to any step costs a binary search, one copy and fewer than that many redos. Checkpoints
+// are a ring too, with a snapshot slot per checkpoint; they only make jumps faster, so when
+// snapshots would take more than MAX_UNDO_SNAPSHOT_BYTES the oldest ones are dropped.
+//
+#define UNDO_CHECKPOINT_INTERVAL 64
+#define MAX_UNDO_SNAPSHOT_BYTES  MEGABYTES(64)
+//
+struct Undo_Checkpoint
 {
-    s32 actions_count;
-    Undo_Action actions[8];
+    u32 step;   // Record position it was taken at.
+    u32 action; // Action position of that record.
+    s32 px, py;
+    u8  pdir;
 };
 
-// @Note: Results in 292KB commit size.
-#define MAX_RECORDS 1000
-//
 struct Undo_Handler
 {
     s32 pending_actions_count;
-    Undo_Action pending_actions[8];
-    Array<Undo_Record> records;
+    Undo_Action pending_actions[MAX_ACTIONS_PER_RECORD];
+    
+    // Each ring has an arena of its own, so it can grow in place.
+    Arena       *actions_arena;
+    Arena       *records_arena;
+    Undo_Action *actions;       // [actions_capacity]
+    u8          *record_counts; // [records_capacity]
+    u32 actions_capacity, records_capacity;
+    u32 first_record, end_record;
+    u32 first_action, end_action;
+    u32 step, step_action;
+    
+    Arena           *checkpoints_arena;
+    Arena           *snapshots_arena;
+    Undo_Checkpoint *checkpoints; // [checkpoints_capacity]
+    u8              *snapshots;   // [checkpoints_capacity][snapshot_size]
+    u32 checkpoints_capacity, max_checkpoints;
+    u32 first_checkpoint, end_checkpoint;
+    u32 snapshot_size;            // 12*squares (see Obj_Map).
 };
 
-FUNCTION void undo_handler_init(Undo_Handler *handler)
+FUNCTION s32 undo_depth(Undo_Handler *handler)
 {
-    handler->pending_actions_count = 0;
-    MEMORY_ZERO_ARRAY(handler->pending_actions);
-    array_init(&handler->records);
+    s32 result = (s32)(handler->step - handler->first_record);
+    return result;
+}
+
+FUNCTION s32 undo_records_count(Undo_Handler *handler)
+{
+    s32 result = (s32)(handler->end_record - handler->first_record);
+    return result;
+}
+
+FUNCTION u64 undo_memory_used(Undo_Handler *handler)
+{
+    u64 result = ((u64)handler->actions_capacity     * sizeof(Undo_Action) +
+                  (u64)handler->records_capacity     +
+                  (u64)handler->checkpoints_capacity * (sizeof(Undo_Checkpoint) + handler->snapshot_size));
+    return result;
+}
+
+FUNCTION b32 undo_ring_fit(Arena *arena, u8 *ring, u64 item_size, u32 *capacity, u32 first, u32 end, u32 needed, u32 max)
+{
+    // @Note: Makes room for `needed` more items after [first, end) by doubling the ring. Its arena
+    // holds nothing else, so the new half lands right after the old one and only the items that
+    // wrapped around have to move. Returns FALSE if the ring would outgrow `max`.
+    //
+    u32 old_capacity = *capacity;
+    u32 new_capacity = old_capacity;
+    while ((u64)(end - first) + needed > new_capacity)
+        new_capacity *= 2;
+    if (new_capacity == old_capacity)
+        return TRUE;
+    if (new_capacity > max)
+        return FALSE;
+    
+    arena_push(arena, (new_capacity - old_capacity)*item_size, 1);
+    for (u32 p = first; p != end; p++) {
+        u32 from = p & (old_capacity-1);
+        u32 to   = p & (new_capacity-1);
+        if (from != to)
+            MEMORY_COPY(ring + to*item_size, ring + from*item_size, item_size);
+    }
+    *capacity = new_capacity;
+    return TRUE;
+}
+
+FUNCTION void undo_checkpoint(Undo_Handler *handler)
+{
+    if (!objmap.type || handler->snapshot_size != 12*(u32)(objmap.pitch*objmap.rows))
+        return;
+    
+    // Checkpoints and their snapshot slots grow together; once they're at the max the oldest goes.
+    if (handler->end_checkpoint - handler->first_checkpoint == handler->checkpoints_capacity) {
+        u32 capacity = handler->checkpoints_capacity;
+        if (undo_ring_fit(handler->checkpoints_arena, (u8 *)handler->checkpoints, sizeof(Undo_Checkpoint), &capacity,
+                          handler->first_checkpoint, handler->end_checkpoint, 1, handler->max_checkpoints)) {
+            undo_ring_fit(handler->snapshots_arena, handler->snapshots, handler->snapshot_size, &handler->checkpoints_capacity,
+                          handler->first_checkpoint, handler->end_checkpoint, 1, handler->max_checkpoints);
+        } else {
+            handler->first_checkpoint++;
+        }
+    }
+    
+    u32 slot = handler->end_checkpoint & (handler->checkpoints_capacity-1);
+    Undo_Checkpoint *c = &handler->checkpoints[slot];
+    c->step   = handler->step;
+    c->action = handler->step_action;
+    c->px     = px;
+    c->py     = py;
+    c->pdir   = pdir;
+    MEMORY_COPY(handler->snapshots + (u64)slot*handler->snapshot_size, objmap.type, handler->snapshot_size);
+    handler->end_checkpoint++;
 }
 
 FUNCTION void undo_handler_reset(Undo_Handler *handler)
 {
-    // @Todo: Is calling this function sufficient when switching levels?
+    // @Note: Also sizes the snapshots for the current level, so call it whenever the level changes.
     //
     handler->pending_actions_count = 0;
     MEMORY_ZERO_ARRAY(handler->pending_actions);
-    array_reset(&handler->records);
+    
+    handler->first_record = handler->end_record  = 0;
+    handler->first_action = handler->end_action  = 0;
+    handler->step         = handler->step_action = 0;
+    
+    arena_reset(handler->checkpoints_arena);
+    arena_reset(handler->snapshots_arena);
+    handler->first_checkpoint     = handler->end_checkpoint = 0;
+    handler->checkpoints_capacity = 1;
+    handler->snapshot_size        = objmap.type? 12*(u32)(objmap.pitch*objmap.rows) : 0;
+    handler->max_checkpoints      = 1;
+    while (handler->snapshot_size && handler->max_checkpoints < MAX_RECORDS/UNDO_CHECKPOINT_INTERVAL &&
+           (u64)handler->max_checkpoints*2*handler->snapshot_size <= MAX_UNDO_SNAPSHOT_BYTES) {
+        handler->max_checkpoints *= 2;
+    }
+    handler->checkpoints = PUSH_ARRAY(handler->checkpoints_arena, Undo_Checkpoint, 1);
+    handler->snapshots   = PUSH_ARRAY(handler->snapshots_arena, u8, handler->snapshot_size);
+    
+    // Step 0 is the state we're resetting to.
+    undo_checkpoint(handler);
+}
+
+FUNCTION void undo_handler_init(Undo_Handler *handler)
+{
+    handler->actions_arena     = arena_init(MAX_UNDO_ACTIONS*sizeof(Undo_Action));
+    handler->records_arena     = arena_init(MAX_RECORDS);
+    handler->actions_capacity  = UNDO_RING_MIN;
+    handler->records_capacity  = UNDO_RING_MIN;
+    handler->actions           = PUSH_ARRAY(handler->actions_arena, Undo_Action, UNDO_RING_MIN);
+    handler->record_counts     = PUSH_ARRAY(handler->records_arena, u8, UNDO_RING_MIN);
+    handler->checkpoints_arena = arena_init(MAX_RECORDS/UNDO_CHECKPOINT_INTERVAL*sizeof(Undo_Checkpoint));
+    handler->snapshots_arena   = arena_init(MAX_UNDO_SNAPSHOT_BYTES);
+    undo_handler_reset(handler);
 }
 
 FUNCTION void undo_push_action(Undo_Handler *handler, Undo_Action new_action)
@@ -82,77 +224,329 @@ FUNCTION void undo_push_action(Undo_Handler *handler, Undo_Action new_action)
 
 FUNCTION void undo_push_player_move(Undo_Handler *handler, s32 x, s32 y, u8 dir)
 {
-    Undo_Action new_action;
+    // @Note: Where the player ends up is filled in by undo_end_frame().
+    Undo_Action new_action = {};
     new_action.type = ActionType_PLAYER_MOVE;
-    new_action.player_move = {x, y, dir};
+    new_action.player_move = {(s16)x, (s16)y, 0, 0, dir, 0};
     undo_push_action(handler, new_action);
 }
 
 FUNCTION void undo_push_obj_move(Undo_Handler *handler, s32 from_x, s32 from_y, s32 to_x, s32 to_y)
 {
-    Undo_Action new_action;
+    Undo_Action new_action = {};
     new_action.type   = ActionType_OBJ_MOVE;
-    new_action.obj_move = {from_x, from_y, to_x, to_y};
+    new_action.obj_move = {(s16)from_x, (s16)from_y, (s16)to_x, (s16)to_y};
     undo_push_action(handler, new_action);
 }
 
 FUNCTION void undo_push_obj_rotate(Undo_Handler *handler, s32 obj_x, s32 obj_y, u8 dir_before)
 {
-    Undo_Action new_action;
+    // @Note: The new direction is filled in by undo_end_frame().
+    Undo_Action new_action = {};
     new_action.type   = ActionType_OBJ_ROTATE;
-    new_action.obj_rotate = {obj_x, obj_y, dir_before};
+    new_action.obj_rotate = {(s16)obj_x, (s16)obj_y, dir_before, 0};
     undo_push_action(handler, new_action);
 }
 
+FUNCTION void undo_drop_oldest(Undo_Handler *handler)
+{
+    u8 count = handler->record_counts[handler->first_record & (handler->records_capacity-1)];
+    handler->first_record++;
+    handler->first_action += count;
+    
+    // Restoring these would need the records we just dropped.
+    while (handler->first_checkpoint != handler->end_checkpoint &&
+           handler->checkpoints[handler->first_checkpoint & (handler->checkpoints_capacity-1)].step < handler->first_record) {
+        handler->first_checkpoint++;
+    }
+}
+
 FUNCTION void undo_end_frame(Undo_Handler *handler)
 {
     s32 count = handler->pending_actions_count;
     if (!count) return;
     
-    Undo_Record new_record; MEMORY_ZERO_STRUCT(&new_record);
-    new_record.actions_count = count;
-    MEMORY_COPY(new_record.actions, handler->pending_actions, count * sizeof(new_record.actions[0]));
+    // A new record drops whatever could have been redone.
+    handler->end_record = handler->step;
+    handler->end_action = handler->step_action;
+    while (handler->first_checkpoint != handler->end_checkpoint &&
+           handler->checkpoints[(handler->end_checkpoint-1) & (handler->checkpoints_capacity-1)].step > handler->step) {
+        handler->end_checkpoint--;
+    }
+    
+    // @Note: If the log is at its max, forget the oldest records until this one fits.
+    while (!undo_ring_fit(handler->records_arena, handler->record_counts, sizeof(u8), &handler->records_capacity,
+                          handler->first_record, handler->end_record, 1, MAX_RECORDS) ||
+           !undo_ring_fit(handler->actions_arena, (u8 *)handler->actions, sizeof(Undo_Action), &handler->actions_capacity,
+                          handler->first_action, handler->end_action, (u32)count, MAX_UNDO_ACTIONS)) {
+        undo_drop_oldest(handler);
+    }
     
-    // @Note: If max records reached. Remove first half of all records.
-    if (handler->records.count >= MAX_RECORDS) {
-        array_remove_range(&handler->records, 0, (MAX_RECORDS/2)-1);
+    for (s32 i = 0; i < count; i++) {
+        Undo_Action a = handler->pending_actions[i];
+        if (a.type == ActionType_PLAYER_MOVE) {
+            a.player_move.to_x   = (s16)px;
+            a.player_move.to_y   = (s16)py;
+            a.player_move.to_dir = pdir;
+        } else if (a.type == ActionType_OBJ_ROTATE) {
+            a.obj_rotate.to_dir  = objmap.dir[MAP_IDX(a.obj_rotate.x, a.obj_rotate.y)];
+        }
+        handler->actions[handler->end_action & (handler->actions_capacity-1)] = a;
+        handler->end_action++;
     }
+    handler->record_counts[handler->end_record & (handler->records_capacity-1)] = (u8)count;
+    handler->end_record++;
+    handler->step        = handler->end_record;
+    handler->step_action = handler->end_action;
     
-    array_add(&handler->records, new_record);
+    if ((handler->step % UNDO_CHECKPOINT_INTERVAL) == 0)
+        undo_checkpoint(handler);
     
     handler->pending_actions_count = 0;
     MEMORY_ZERO_ARRAY(handler->pending_actions);
 }
 
-FUNCTION void undo_perform_action(Undo_Action action)
+FUNCTION void undo_perform_action(Undo_Action action, b32 redo)
 {
     switch (action.type) {
         case ActionType_NONE: return;
         case ActionType_PLAYER_MOVE: {
             Player_Move c = action.player_move;
-            set_player_position(c.x, c.y, c.dir, TRUE);
+            if (redo) set_player_position(c.to_x,   c.to_y,   c.to_dir,   TRUE);
+            else      set_player_position(c.from_x, c.from_y, c.from_dir, TRUE);
         } break;
         case ActionType_OBJ_MOVE: {
+            // Swapping is its own inverse.
             Obj_Move c = action.obj_move;
-            SWAP(objmap[c.to_y][c.to_x], objmap[c.from_y][c.from_x], Obj);
+            swap_objs(&objmap, MAP_IDX(c.to_x, c.to_y), MAP_IDX(c.from_x, c.from_y));
+            obj_index_swap(&obj_index, c.from_x, c.from_y, c.to_x, c.to_y);
+            beams_mark_dirty(&beam_tracer, c.from_x, c.from_y);
+            beams_mark_dirty(&beam_tracer, c.to_x, c.to_y);
             pushed_obj = pushed_obj_pos = {};
         } break;
         case ActionType_OBJ_ROTATE: {
             Obj_Rotate c = action.obj_rotate;
-            objmap[c.y][c.x].dir = c.dir;
+            objmap.dir[MAP_IDX(c.x, c.y)] = redo? c.to_dir : c.from_dir;
+            beams_mark_dirty(&beam_tracer, c.x, c.y);
         } break;
     }
 }
 
+FUNCTION void undo_perform_record(Undo_Handler *handler, u32 first_action, u32 count, b32 redo)
+{
+    // @Note: Actions of a record can touch the same square (a push and then a rotation of the
+    // pushed obj at its new spot), so undoing goes newest first and redoing oldest first.
+    //
+    for (u32 i = 0; i < count; i++) {
+        u32 idx = redo? i : count-1 - i;
+        undo_perform_action(handler->actions[(first_action + idx) & (handler->actions_capacity-1)], redo);
+    }
+}
+
 FUNCTION b32 undo_next(Undo_Handler *handler)
 {
-    if (handler->records.count <= 0)
+    if (handler->step == handler->first_record)
+        return FALSE;
+    
+    handler->step--;
+    u8 count = handler->record_counts[handler->step & (handler->records_capacity-1)];
+    handler->step_action -= count;
+    undo_perform_record(handler, handler->step_action, count, FALSE);
+    
+    return TRUE;
+}
+
+FUNCTION b32 undo_redo(Undo_Handler *handler)
+{
+    if (handler->step == handler->end_record)
         return FALSE;
     
-    Undo_Record record = array_pop_back(&handler->records);
-    for (s32 i = 0; i < record.actions_count; i++) {
-        undo_perform_action(record.actions[i]);
+    u8 count = handler->record_counts[handler->step & (handler->records_capacity-1)];
+    undo_perform_record(handler, handler->step_action, count, TRUE);
+    handler->step++;
+    handler->step_action += count;
+    
+    return TRUE;
+}
+
+FUNCTION b32 undo_restore_checkpoint(Undo_Handler *handler, u32 checkpoint)
+{
+    u32 slot = checkpoint & (handler->checkpoints_capacity-1);
+    Undo_Checkpoint *c = &handler->checkpoints[slot];
+    if (handler->snapshot_size != 12*(u32)(objmap.pitch*objmap.rows))
+        return FALSE;
+    
+    MEMORY_COPY(objmap.type, handler->snapshots + (u64)slot*handler->snapshot_size, handler->snapshot_size);
+    set_player_position(c->px, c->py, c->pdir, TRUE);
+    obj_index.rebuild  = TRUE;
+    door_index.rebuild = TRUE;
+    beams_mark_all_dirty(&beam_tracer);
+    pushed_obj = pushed_obj_pos = {};
+    handler->step        = c->step;
+    handler->step_action = c->action;
+    
+    return TRUE;
+}
+
+FUNCTION void undo_jump(Undo_Handler *handler, s32 target)
+{
+    // @Note: Go to any step of the history (0 is the oldest we still have). Steps close to the
+    // current one are walked to; anything further restores the closest checkpoint at or before the
+    // target (binary search) and redoes the rest.
+    //
+    u32 step = handler->first_record + (u32)CLAMP(0, target, undo_records_count(handler));
+    
+    u32 lo = handler->first_checkpoint, hi = handler->end_checkpoint, found = hi;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo)/2;
+        if (handler->checkpoints[mid & (handler->checkpoints_capacity-1)].step <= step) {
+            found = mid;
+            lo    = mid + 1;
+        } else {
+            hi    = mid;
+        }
+    }
+    
+    u32 walk = step > handler->step? step - handler->step : handler->step - step;
+    if (found != handler->end_checkpoint &&
+        (step - handler->checkpoints[found & (handler->checkpoints_capacity-1)].step) < walk) {
+        undo_restore_checkpoint(handler, found);
+    }
+    
+    while (handler->step > step) undo_next(handler);
+    while (handler->step < step) undo_redo(handler);
+}
+
+FUNCTION void undo_save_ring(String_Builder *sb, u8 *ring, u64 item_size, u32 capacity, u32 first, u32 end)
+{
+    // Oldest first; the part that wrapped around comes second.
+    u32 count = end - first;
+    u32 start = first & (capacity-1);
+    u32 head  = MIN(count, capacity - start);
+    sb_append(sb, ring + start*item_size, head*item_size);
+    sb_append(sb, ring, (count - head)*item_size);
+}
+
+// @Note: The log goes to save.dat oldest record first (see save_level_state()); checkpoints aren't
+// saved, they're rebuilt from the state the log ends at.
+//
+FUNCTION void undo_save(Undo_Handler *handler, String_Builder *sb)
+{
+    s32 depth         = undo_depth(handler);
+    s32 records_count = undo_records_count(handler);
+    s32 actions_count = (s32)(handler->end_action - handler->first_action);
+    b32 from_start    = handler->first_record == 0;
+    
+    sb_append(sb, &depth);
+    sb_append(sb, &records_count);
+    sb_append(sb, &actions_count);
+    sb_append(sb, &from_start);
+    undo_save_ring(sb, handler->record_counts, sizeof(u8), handler->records_capacity, handler->first_record, handler->end_record);
+    undo_save_ring(sb, (u8 *)handler->actions, sizeof(Undo_Action), handler->actions_capacity, handler->first_action, handler->end_action);
+}
+
+FUNCTION b32 undo_action_valid(Undo_Action a, s32 pitch, s32 rows)
+{
+#define UNDO_SQUARE_VALID(x, y) ((x) >= 0 && (x) < pitch && (y) >= 0 && (y) < rows)
+    b32 result = FALSE;
+    switch (a.type) {
+        case ActionType_PLAYER_MOVE: {
+            Player_Move c = a.player_move;
+            result = (UNDO_SQUARE_VALID(c.from_x, c.from_y) && UNDO_SQUARE_VALID(c.to_x, c.to_y) &&
+                      c.from_dir < 8 && c.to_dir < 8);
+        } break;
+        case ActionType_OBJ_MOVE: {
+            Obj_Move c = a.obj_move;
+            result = UNDO_SQUARE_VALID(c.from_x, c.from_y) && UNDO_SQUARE_VALID(c.to_x, c.to_y);
+        } break;
+        case ActionType_OBJ_ROTATE: {
+            Obj_Rotate c = a.obj_rotate;
+            result = UNDO_SQUARE_VALID(c.x, c.y) && c.from_dir < 8 && c.to_dir < 8;
+        } break;
+    }
+    return result;
+#undef UNDO_SQUARE_VALID
+}
+
+FUNCTION b32 undo_log_valid(String8 file)
+{
+    // @Note: Checks a saved log against the live level without touching anything, so the caller
+    // can reject the whole save before applying any of it. Actions end up in MAP_IDX(), so every
+    // square has to be on the map.
+    //
+    s32 depth = 0, records_count = 0, actions_count = 0;
+    b32 from_start = FALSE;
+    if (file.count < 3*sizeof(s32) + sizeof(b32))
+        return FALSE;
+    get(&file, &depth);
+    get(&file, &records_count);
+    get(&file, &actions_count);
+    get(&file, &from_start);
+    
+    if (records_count < 0 || records_count > MAX_RECORDS || actions_count < 0 || actions_count > MAX_UNDO_ACTIONS ||
+        depth < 0 || depth > records_count)
+        return FALSE;
+    if (file.count < (u64)records_count + (u64)actions_count*sizeof(Undo_Action))
+        return FALSE;
+    
+    // Records must cover the actions exactly, or undoing would read garbage.
+    s64 total = 0;
+    for (s32 i = 0; i < records_count; i++) {
+        u8 count = file.data[i];
+        if (count == 0 || count > MAX_ACTIONS_PER_RECORD)
+            return FALSE;
+        total += count;
     }
+    if (total != actions_count)
+        return FALSE;
+    
+    u8 *actions = file.data + records_count;
+    for (s32 i = 0; i < actions_count; i++) {
+        Undo_Action a;
+        MEMORY_COPY(&a, actions + (u64)i*sizeof(Undo_Action), sizeof(Undo_Action));
+        if (!undo_action_valid(a, objmap.pitch, objmap.rows))
+            return FALSE;
+    }
+    
+    return TRUE;
+}
+
+FUNCTION b32 undo_load(Undo_Handler *handler, String8 *file)
+{
+    // @Note: Call after reload_map() and after the level is put in the state the saved log was at;
+    // that state becomes a checkpoint, next to the pristine one reload_map() took at step 0 (if the
+    // log still reaches back that far).
+    //
+    if (!undo_log_valid(*file))
+        return FALSE;
+    
+    s32 depth = 0, records_count = 0, actions_count = 0;
+    b32 from_start = FALSE;
+    get(file, &depth);
+    get(file, &records_count);
+    get(file, &actions_count);
+    get(file, &from_start);
+    u64 actions_size = (u64)actions_count*sizeof(Undo_Action);
+    
+    handler->pending_actions_count = 0;
+    handler->first_record = handler->end_record = 0;
+    handler->first_action = handler->end_action = 0;
+    undo_ring_fit(handler->records_arena, handler->record_counts, sizeof(u8), &handler->records_capacity, 0, 0, (u32)records_count, MAX_RECORDS);
+    undo_ring_fit(handler->actions_arena, (u8 *)handler->actions, sizeof(Undo_Action), &handler->actions_capacity, 0, 0, (u32)actions_count, MAX_UNDO_ACTIONS);
+    get(file, handler->record_counts, (u64)records_count);
+    get(file, handler->actions, actions_size);
+    handler->end_record = (u32)records_count;
+    handler->end_action = (u32)actions_count;
+    
+    handler->step        = (u32)depth;
+    handler->step_action = 0;
+    for (s32 i = 0; i < depth; i++)
+        handler->step_action += handler->record_counts[i];
+    
+    // Keep only the pristine checkpoint, and only if step 0 still is the level's start.
+    handler->end_checkpoint = handler->first_checkpoint + MIN(handler->end_checkpoint - handler->first_checkpoint, from_start? 1u : 0u);
+    if (depth)
+        undo_checkpoint(handler);
     
     return TRUE;
 }
@@ -148,17 +148,68 @@ FUNCTION String8 win32_read_entire_file(String8 full_path)
     return result;
 }
 
+FUNCTION String8 win32_map_file(String8 full_path)
+{
+    // @Note: Closing the file and mapping handles is fine; the view keeps the mapping alive until
+    // win32_unmap_file().
+    //
+    String8 result = {};
+    
+    HANDLE file_handle = CreateFile((char*)full_path.data, GENERIC_READ, FILE_SHARE_READ, 0, 
+                                    OPEN_EXISTING, 0, 0);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        print("OS Error: map_file() INVALID_HANDLE_VALUE!\n");
+        return result;
+    }
+    
+    LARGE_INTEGER file_size64;
+    if (GetFileSizeEx(file_handle, &file_size64) && file_size64.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingA(file_handle, 0, PAGE_READONLY, 0, 0, 0);
+        if (mapping) {
+            result.data = (u8 *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if (result.data)
+                result.count = (u64)file_size64.QuadPart;
+            else
+                print("OS Error: map_file() MapViewOfFile() failed!\n");
+            CloseHandle(mapping);
+        } else {
+            print("OS Error: map_file() CreateFileMappingA() failed!\n");
+        }
+    } else {
+        print("OS Error: map_file() file is empty or GetFileSizeEx() failed!\n");
+    }
+    
+    CloseHandle(file_handle);
+    
+    return result;
+}
+
+FUNCTION void win32_unmap_file(String8 file)
+{
+    if (file.data) {
+        UnmapViewOfFile(file.data);
+    }
+}
+
 FUNCTION b32 win32_write_entire_file(String8 full_path, String8 data)
 {
+    // @Note: Write to a temporary file, flush it to disk, then rename it over the destination, so
+    // a crash or power loss leaves either the old file or the new one, never a torn one.
+    //
     b32 result = FALSE;
     
-    HANDLE file_handle = CreateFile((char*)full_path.data, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
+    char temp_path[MAX_PATH];
+    string_format(temp_path, sizeof(temp_path), "%S.tmp", full_path);
+    
+    HANDLE file_handle = CreateFile(temp_path, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
     if (file_handle == INVALID_HANDLE_VALUE) {
         print("OS Error: write_entire_file() INVALID_HANDLE_VALUE!\n");
+        return result;
     }
     
     DWORD bytes_written;
-    if (WriteFile(file_handle, data.data, (DWORD)data.count, &bytes_written, 0) && (bytes_written == data.count)) {
+    if (WriteFile(file_handle, data.data, (DWORD)data.count, &bytes_written, 0) && (bytes_written == data.count) &&
+        FlushFileBuffers(file_handle)) {
         result = TRUE;
     } else {
         print("OS Error: write_entire_file() WriteFile() failed!\n");
@@ -166,12 +217,150 @@ FUNCTION b32 win32_write_entire_file(String8 full_path, String8 data)
     
     CloseHandle(file_handle);
     
+    if (result) {
+        result = MoveFileExA(temp_path, (char*)full_path.data, MOVEFILE_REPLACE_EXISTING|MOVEFILE_WRITE_THROUGH);
+        if (!result)
+            print("OS Error: write_entire_file() MoveFileExA() failed!\n");
+    } 
+    if (!result)
+        DeleteFileA(temp_path);
+    
     return result;
 }
 
+////////////////////////////////
+// Background file writer.
+//
+// @Note: write_entire_file_async() copies the request into an allocation of its own size, queues it
+// and returns; a single writer thread drains the queue in order. The caller never waits: if a
+// request for the same file is still waiting, we replace it instead, since only the latest
+// contents matter, and otherwise the queue just gets longer.
+//
+struct Win32_File_Write
+{
+    Win32_File_Write *next;
+    String8 path; // Null-terminated. Path and data live right after the struct.
+    String8 data;
+};
+
+struct Win32_File_Writer
+{
+    SRWLOCK            lock;
+    CONDITION_VARIABLE changed;
+    HANDLE             thread;
+    
+    Win32_File_Write *first; // Waiting, oldest first.
+    Win32_File_Write *last;
+    s32 count;               // Waiting, plus the one being written.
+};
+GLOBAL Win32_File_Writer global_file_writer;
+
+FUNCTION Win32_File_Write* win32_file_write_alloc(String8 full_path, String8 data)
+{
+    // VirtualAlloc() zeroes the memory, so the path is already terminated.
+    u64 size = sizeof(Win32_File_Write) + full_path.count + 1 + data.count;
+    Win32_File_Write *result = (Win32_File_Write *) VirtualAlloc(0, size, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+    if (!result) {
+        print("OS Error: write_entire_file_async() VirtualAlloc() returned 0!\n");
+        return result;
+    }
+    
+    result->path.data  = (u8 *)(result + 1);
+    result->path.count = full_path.count;
+    result->data.data  = result->path.data + full_path.count + 1;
+    result->data.count = data.count;
+    MEMORY_COPY(result->path.data, full_path.data, full_path.count);
+    MEMORY_COPY(result->data.data, data.data, data.count);
+    
+    return result;
+}
+
+FUNCTION DWORD WINAPI win32_file_writer_thread(LPVOID param)
+{
+    Win32_File_Writer *writer = (Win32_File_Writer *)param;
+    
+    for (;;) {
+        AcquireSRWLockExclusive(&writer->lock);
+        while (!writer->first)
+            SleepConditionVariableSRW(&writer->changed, &writer->lock, INFINITE, 0);
+        Win32_File_Write *write = writer->first;
+        writer->first           = write->next;
+        if (!writer->first)
+            writer->last = 0;
+        ReleaseSRWLockExclusive(&writer->lock);
+        
+        if (!win32_write_entire_file(write->path, write->data))
+            print("OS Error: Couldn't write %S in the background!\n", write->path);
+        VirtualFree(write, 0, MEM_RELEASE);
+        
+        AcquireSRWLockExclusive(&writer->lock);
+        writer->count--;
+        ReleaseSRWLockExclusive(&writer->lock);
+        WakeAllConditionVariable(&writer->changed);
+    }
+}
+
+FUNCTION void win32_file_writer_init(Win32_File_Writer *writer)
+{
+    InitializeSRWLock(&writer->lock);
+    InitializeConditionVariable(&writer->changed);
+    writer->thread = CreateThread(0, 0, win32_file_writer_thread, writer, 0, 0);
+}
+
+FUNCTION void win32_write_entire_file_async(String8 full_path, String8 data)
+{
+    Win32_File_Writer *writer = &global_file_writer;
+    
+    Win32_File_Write *write = win32_file_write_alloc(full_path, data);
+    if (!write) {
+        // Better late than never.
+        win32_write_entire_file(full_path, data);
+        return;
+    }
+    
+    AcquireSRWLockExclusive(&writer->lock);
+    
+    // Replace a waiting request for the same file, if any.
+    Win32_File_Write *replaced = 0;
+    for (Win32_File_Write **it = &writer->first; *it; it = &(*it)->next) {
+        if ((*it)->path == full_path) {
+            replaced    = *it;
+            write->next = replaced->next;
+            *it         = write;
+            if (writer->last == replaced)
+                writer->last = write;
+            break;
+        }
+    }
+    
+    if (!replaced) {
+        if (writer->last)
+            writer->last->next = write;
+        else
+            writer->first = write;
+        writer->last = write;
+        writer->count++;
+    }
+    
+    ReleaseSRWLockExclusive(&writer->lock);
+    WakeAllConditionVariable(&writer->changed);
+    
+    if (replaced)
+        VirtualFree(replaced, 0, MEM_RELEASE);
+}
+
+FUNCTION void win32_wait_for_file_writes()
+{
+    Win32_File_Writer *writer = &global_file_writer;
+    AcquireSRWLockExclusive(&writer->lock);
+    while (writer->count > 0)
+        SleepConditionVariableSRW(&writer->changed, &writer->lock, INFINITE, 0);
+    ReleaseSRWLockExclusive(&writer->lock);
+}
+
 FUNCTION Sound win32_sound_load(String8 full_path, u32 sample_rate)
 {
-    String8 file = win32_read_entire_file(full_path);
+    String8 file = win32_map_file(full_path);
     if (!file.data) {
         print("Couldn't load sound file %S\n", full_path);
         
@@ -182,6 +371,7 @@ FUNCTION Sound win32_sound_load(String8 full_path, u32 sample_rate)
     s16 *out;
     s32 chan, samplerate;
     s32 count = stb_vorbis_decode_memory(file.data, (s32)file.count, &chan, &samplerate, &out);
+    win32_unmap_file(file);
     
     if (count == -1) {
         print("STB Error: Couldn't load sound file %S\n", full_path);
@@ -624,12 +814,19 @@ int WINAPI WinMain(HINSTANCE instance, HINSTANCE prev_instance,
         global_os.print_to_console  = win32_print_to_console;
         global_os.read_entire_file  = win32_read_entire_file;
         global_os.write_entire_file = win32_write_entire_file;
+        global_os.write_entire_file_async = win32_write_entire_file_async;
+        global_os.wait_for_file_writes    = win32_wait_for_file_writes;
         global_os.free_file_memory  = win32_free_file_memory;
+        global_os.map_file          = win32_map_file;
+        global_os.unmap_file        = win32_unmap_file;
         global_os.sound_load        = win32_sound_load;
         
         // Arenas.
         global_os.permanent_arena  = arena_init();
         
+        // Background file writer.
+        win32_file_writer_init(&global_file_writer);
+        
         // User Input.
         array_init_static(&global_os.inputs_to_process, 512);
         
@@ -835,5 +1032,8 @@ int WINAPI WinMain(HINSTANCE instance, HINSTANCE prev_instance,
 #endif
     wasapi_stop(&audio);
     
+    // Don't exit before the saves are on disk.
+    win32_wait_for_file_writes();
+    
     return 0;
 }
\ No newline at end of file